@@ -0,0 +1,92 @@
+#ifndef QWD0_COMPACTCANDIDATES_H
+#define QWD0_COMPACTCANDIDATES_H
+
+#include <vector>
+
+#include "DataFormats/Common/interface/Handle.h"
+#include "DataFormats/TrackReco/interface/TrackFwd.h"
+#include "DataFormats/Candidate/interface/VertexCompositeCandidateFwd.h"
+#include "QWAna/QWD0Producer/interface/QWD0FittedPair.h"
+
+// The candidates of one QWD0Fitter hypothesis as columns with one row per
+// fitted pair instead of one VertexCompositeCandidate per mass assignment:
+// the pair holds the vertex and momenta once, the masses of both
+// assignments and the selection variables are stored next to it.
+// expand() builds the VertexCompositeCandidates from the rows, in the order
+// and with the pdgIds QWD0Fitter gives them, up to single precision.
+class QWD0CompactCandidates {
+public:
+	// bits of assignments(), the daughter taking mass1; kChosenAssignment
+	// marks rows where both assignments were in the window and massAssignment
+	// kept only the one set
+	enum Assignment {
+		kFirstIsMass1 = 1,
+		kSecondIsMass1 = 2,
+		kChosenAssignment = 4
+	};
+
+	QWD0CompactCandidates();
+
+	void setHypothesis(double mass1, double mass2, int pdgId, int sameSignPdgId, bool chargeConjugate);
+	double mass1() const { return mass1_; }
+	double mass2() const { return mass2_; }
+	int pdgId() const { return pdgId_; }
+	int sameSignPdgId() const { return sameSignPdgId_; }
+	bool chargeConjugate() const { return chargeConjugate_; }
+
+	size_t size() const { return pairs_.size(); }
+	void reserve(size_t n);
+	void clear();
+	void push_back(const QWD0FittedPair & pair, int charge1, int charge2, unsigned assignments,
+			double mass12, double mass21, double dca, double mPiPi,
+			double decaySigXY, double decaySigXYZ, double cosThetaXY, double cosThetaXYZ);
+	// moves the rows of other to the end
+	void append(QWD0CompactCandidates & other);
+	// keeps only the rows in rows, in increasing order
+	void keepOnly(const std::vector<unsigned> & rows);
+	// keeps the first counts[i] candidates of row i, in the order expand()
+	// gives them, dropping the rows left without one
+	void keepCandidates(const std::vector<unsigned> & counts);
+
+	const QWD0FittedPair & pair(size_t i) const { return pairs_[i]; }
+	int charge1(size_t i) const { return charge1_[i]; }
+	int charge2(size_t i) const { return charge2_[i]; }
+	unsigned assignments(size_t i) const { return assignments_[i]; }
+	bool chosenAssignment(size_t i) const { return assignments_[i] & kChosenAssignment; }
+	// with the first daughter as mass1 and as mass2
+	double mass12(size_t i) const { return mass12_[i]; }
+	double mass21(size_t i) const { return mass21_[i]; }
+	double dca(size_t i) const { return dca_[i]; }
+	double mPiPi(size_t i) const { return mPiPi_[i]; }
+	double decaySigXY(size_t i) const { return decaySigXY_[i]; }
+	double decaySigXYZ(size_t i) const { return decaySigXYZ_[i]; }
+	double cosThetaXY(size_t i) const { return cosThetaXY_[i]; }
+	double cosThetaXYZ(size_t i) const { return cosThetaXYZ_[i]; }
+
+	// appends the candidates of row i or of all rows, with the daughter
+	// tracks taken from the track collection the producer read
+	void expand(size_t i, const edm::Handle<reco::TrackCollection> & tracks, reco::VertexCompositeCandidateCollection & out) const;
+	void expand(const edm::Handle<reco::TrackCollection> & tracks, reco::VertexCompositeCandidateCollection & out) const;
+
+protected:
+	double mass1_;
+	double mass2_;
+	int pdgId_;
+	int sameSignPdgId_;
+	bool chargeConjugate_;
+
+	std::vector<QWD0FittedPair> pairs_;
+	std::vector<short> charge1_;
+	std::vector<short> charge2_;
+	std::vector<unsigned char> assignments_;
+	std::vector<float> mass12_;
+	std::vector<float> mass21_;
+	std::vector<float> dca_;
+	std::vector<float> mPiPi_;
+	std::vector<float> decaySigXY_;
+	std::vector<float> decaySigXYZ_;
+	std::vector<float> cosThetaXY_;
+	std::vector<float> cosThetaXYZ_;
+};
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef QWD0_CUTFLOW_H
+#define QWD0_CUTFLOW_H
+
+#include <vector>
+
+// Number of track pairs removed by each selection step of QWD0Fitter::fitAll
+// and the time spent in each of its stages, summed over the events of a
+// luminosity block (or of a job).
+class QWD0Cutflow {
+public:
+	// in the order they are applied in fitAll
+	enum Cut {
+		kPrefilter,
+		kCharge,
+		kImpactPointTSCP,
+		kClosestApproach,
+		kDCA,
+		kFiducial,
+		kCrossingTSCP,
+		kQuadrant,
+		kMPiPi,
+		kPrefitD0Mass,
+		kAnalyticVertex,
+		kFitBudget,
+		kVertexFit,
+		kVtxChi2,
+		kVtxProb,
+		kDecaySigXY,
+		kDecaySigXYZ,
+		kInnerHitPos,
+		kVertexTSCP,
+		kCosThetaXY,
+		kCosThetaXYZ,
+		// no hypothesis accepted the pair
+		kD0Mass,
+		nCuts
+	};
+
+	enum Stage {
+		kPreselectionStage,
+		kPairingStage,
+		kPrefilterStage,
+		kClosestApproachStage,
+		kCrossingTSCPStage,
+		kAnalyticVertexStage,
+		kVertexFitStage,
+		kVertexTSCPStage,
+		kCandidateStage,
+		nStages
+	};
+
+	QWD0Cutflow();
+
+	unsigned long long nEvents() const { return nEvents_; }
+	unsigned long long nTracks() const { return nTracks_; }
+	unsigned long long nSelected() const { return nSelected_; }
+	unsigned long long nPairs() const { return nPairs_; }
+	unsigned long long nCandidates() const { return nCandidates_; }
+	unsigned long long rejected(Cut cut) const { return rejected_[cut]; }
+	// pairs left after this cut
+	unsigned long long remaining(Cut cut) const;
+	// seconds
+	double time(Stage stage) const { return 1e-9*stageNanoseconds_[stage]; }
+	unsigned long long calls(Stage stage) const { return stageCalls_[stage]; }
+	unsigned long long nanoseconds(Stage stage) const { return stageNanoseconds_[stage]; }
+
+	void clear();
+	bool mergeProduct(const QWD0Cutflow & other);
+
+	static const char * cutName(Cut cut);
+	static const char * stageName(Stage stage);
+
+protected:
+	unsigned long long nEvents_;
+	unsigned long long nTracks_;
+	unsigned long long nSelected_;
+	unsigned long long nPairs_;
+	unsigned long long nCandidates_;
+	// indexed by Cut
+	std::vector<unsigned long long> rejected_;
+	// indexed by Stage
+	std::vector<unsigned long long> stageNanoseconds_;
+	std::vector<unsigned long long> stageCalls_;
+};
+
+#endif
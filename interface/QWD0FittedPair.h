@@ -0,0 +1,53 @@
+#ifndef QWD0_FITTEDPAIR_H
+#define QWD0_FITTEDPAIR_H
+
+#include <vector>
+
+#include "DataFormats/Math/interface/Point3D.h"
+#include "DataFormats/Math/interface/Vector3D.h"
+#include "DataFormats/Math/interface/Error.h"
+
+// A two-track vertex fitted by QWD0Fitter::fitAll that passed the vertex
+// cuts shared by all hypotheses, for modules that build on the same pairs
+// instead of refitting them. The tracks are given by their keys in the
+// track collection read by the producer, the momenta are the ones at the
+// vertex the candidates are built from. Stored in single precision.
+class QWD0FittedPair {
+public:
+	typedef math::XYZPoint Point;
+	typedef math::XYZVector Vector;
+	typedef math::Error<3>::type CovarianceMatrix;
+
+	QWD0FittedPair();
+	QWD0FittedPair(unsigned key1, unsigned key2, const Point & position, const CovarianceMatrix & covariance,
+			double chi2, double ndof, const Vector & momentum1, const Vector & momentum2);
+
+	// key1 < key2
+	unsigned key1() const { return key1_; }
+	unsigned key2() const { return key2_; }
+	Point position() const { return Point(position_[0], position_[1], position_[2]); }
+	CovarianceMatrix covariance() const;
+	double covariance(int i, int j) const { return covariance_[index(i, j)]; }
+	double chi2() const { return chi2_; }
+	double ndof() const { return ndof_; }
+	double normalizedChi2() const { return ndof_ > 0 ? chi2_/ndof_ : 0.; }
+	Vector momentum1() const { return Vector(momentum1_[0], momentum1_[1], momentum1_[2]); }
+	Vector momentum2() const { return Vector(momentum2_[0], momentum2_[1], momentum2_[2]); }
+
+protected:
+	// position in the upper triangle, row by row
+	static int index(int i, int j) { return i <= j ? i*(5 - i)/2 + j : j*(5 - j)/2 + i; }
+
+	unsigned key1_;
+	unsigned key2_;
+	float position_[3];
+	float covariance_[6];
+	float chi2_;
+	float ndof_;
+	float momentum1_[3];
+	float momentum2_[3];
+};
+
+typedef std::vector<QWD0FittedPair> QWD0FittedPairCollection;
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef QWD0_STAGETIMES_H
+#define QWD0_STAGETIMES_H
+
+#include <vector>
+
+#include "QWAna/QWD0Producer/interface/QWD0Cutflow.h"
+
+// The time QWD0Fitter::fitAll spent in each of its stages in one event, for
+// monitoring modules to follow the stages on production inputs. With the
+// parallel pair loop it is the sum over the threads.
+class QWD0StageTimes {
+public:
+	QWD0StageTimes() : nTracks_(0), nFits_(0), eventNanoseconds_(0), nanoseconds_(QWD0Cutflow::nStages, 0), calls_(QWD0Cutflow::nStages, 0) {}
+
+	// tracks in the pair loop, after the preselection and multiplicity steps
+	unsigned nTracks() const { return nTracks_; }
+	// wall clock time of the whole fitAll call, seconds
+	double eventTime() const { return 1e-9*eventNanoseconds_; }
+	// vertex fits run in the event
+	unsigned nFits() const { return nFits_; }
+
+	// seconds
+	double time(QWD0Cutflow::Stage stage) const { return 1e-9*nanoseconds_[stage]; }
+	unsigned long long calls(QWD0Cutflow::Stage stage) const { return calls_[stage]; }
+	double total() const {
+		unsigned long long ns = 0;
+		for (unsigned long long n : nanoseconds_) ns += n;
+		return 1e-9*ns;
+	}
+
+	void set(QWD0Cutflow::Stage stage, unsigned long long nanoseconds, unsigned long long calls) {
+		nanoseconds_[stage] = nanoseconds;
+		calls_[stage] = calls;
+	}
+	void setEvent(unsigned nTracks, unsigned nFits, unsigned long long eventNanoseconds) {
+		nTracks_ = nTracks;
+		nFits_ = nFits;
+		eventNanoseconds_ = eventNanoseconds;
+	}
+
+protected:
+	unsigned nTracks_;
+	unsigned nFits_;
+	unsigned long long eventNanoseconds_;
+	// indexed by QWD0Cutflow::Stage
+	std::vector<unsigned long long> nanoseconds_;
+	std::vector<unsigned long long> calls_;
+};
+
+#endif
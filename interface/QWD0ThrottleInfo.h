@@ -0,0 +1,56 @@
+#ifndef QWD0_THROTTLEINFO_H
+#define QWD0_THROTTLEINFO_H
+
+// What QWD0Fitter::fitAll did to bound its time in one event, so analyses
+// can correct for it: the multiplicity step whose tighter track cuts were
+// applied, and whether the vertex fit budget cut the pair loop short.
+class QWD0ThrottleInfo {
+public:
+	QWD0ThrottleInfo() :
+		nPreselected_(0),
+		step_(-1),
+		tkPtCut_(0.),
+		tkIPSigXYCut_(0.),
+		nFits_(0),
+		nSkippedFits_(0)
+	{
+	}
+
+	QWD0ThrottleInfo(unsigned nPreselected, int step, float tkPtCut, float tkIPSigXYCut) :
+		nPreselected_(nPreselected),
+		step_(step),
+		tkPtCut_(tkPtCut),
+		tkIPSigXYCut_(tkIPSigXYCut),
+		nFits_(0),
+		nSkippedFits_(0)
+	{
+	}
+
+	// tracks passing the configured preselection, before any tightening
+	unsigned nPreselected() const { return nPreselected_; }
+	// index into multiplicitySteps, -1 if the event stayed below all of them
+	int step() const { return step_; }
+	bool tightened() const { return step_ >= 0; }
+	// the track cuts applied in the event
+	float tkPtCut() const { return tkPtCut_; }
+	float tkIPSigXYCut() const { return tkIPSigXYCut_; }
+	// vertex fits run, and pairs that would have been fitted beyond the budget
+	unsigned nFits() const { return nFits_; }
+	unsigned nSkippedFits() const { return nSkippedFits_; }
+	bool truncated() const { return nSkippedFits_ > 0; }
+
+	void setFits(unsigned nFits, unsigned nSkippedFits) {
+		nFits_ = nFits;
+		nSkippedFits_ = nSkippedFits;
+	}
+
+protected:
+	unsigned nPreselected_;
+	int step_;
+	float tkPtCut_;
+	float tkIPSigXYCut_;
+	unsigned nFits_;
+	unsigned nSkippedFits_;
+};
+
+#endif
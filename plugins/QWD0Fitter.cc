@@ -0,0 +1,1196 @@
+#include "QWD0Fitter.h"
+
+#include "TrackingTools/TransientTrack/interface/TransientTrackBuilder.h"
+#include "TrackingTools/Records/interface/TransientTrackRecord.h"
+#include "TrackingTools/PatternTools/interface/ClosestApproachInRPhi.h"
+#include "Geometry/CommonDetUnit/interface/GlobalTrackingGeometry.h"
+#include "FWCore/MessageLogger/interface/MessageLogger.h"
+#include "FWCore/Utilities/interface/Exception.h"
+#include "TrackingTools/TrajectoryState/interface/TrajectoryStateTransform.h"
+#include "TrackingTools/PatternTools/interface/TSCBLBuilderNoMaterial.h"
+#include <Math/Functions.h>
+#include <Math/SVector.h>
+#include <Math/SMatrix.h>
+#include <typeinfo>
+#include <memory>
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include "tbb/parallel_for.h"
+#include "DataFormats/VertexReco/interface/Vertex.h"
+
+typedef ROOT::Math::SMatrix<double, 3, 3, ROOT::Math::MatRepSym<double, 3> > SMatrixSym3D;
+typedef ROOT::Math::SVector<double, 3> SVector3;
+
+// pdg mass constants
+namespace {
+	const double piMass = 0.13957018;
+	const double piMassSquared = piMass*piMass;
+	const double kaonMass = 0.493667;
+	const double D0Mass = 1.86484;
+
+	// the candidates reserved are the expected ones with a margin, at most
+	// reserveGrowth times those of the last event plus reserveFloor
+	const double reserveMargin = 1.25;
+	const size_t reserveGrowth = 4;
+	const size_t reserveFloor = 64;
+
+	// move one collection of every chunk, in chunk order, to the end of to
+	template <class Collection, class Chunks, class Get>
+	void concatenate(Collection & to, Chunks & chunks, Get get) {
+		size_t n = to.size();
+		for (auto & chunk : chunks) n += get(chunk).size();
+		to.reserve(n);
+		for (auto & chunk : chunks) {
+			Collection & from = get(chunk);
+			std::move(from.begin(), from.end(), std::back_inserter(to));
+			from.clear();
+		}
+	}
+
+	// the candidates of one pair in one hypothesis, as the caps see them: a
+	// VertexCompositeCandidate is one, a compact row one per assignment. The
+	// probability is from the single precision chi2 of QWD0FittedPair, so
+	// every product ranks a pair the same.
+	struct CapEntry {
+		double prob;
+		unsigned key1;
+		unsigned key2;
+		unsigned nCandidates;
+	};
+
+	double pairProb(double chi2, double ndof) {
+		return TMath::Prob(float(chi2), float(ndof));
+	}
+
+	std::vector<CapEntry> capEntries(const reco::VertexCompositeCandidateCollection & cands) {
+		std::vector<CapEntry> entries(cands.size());
+		for (unsigned i = 0; i < cands.size(); ++i) {
+			entries[i] = CapEntry{pairProb(cands[i].vertexChi2(), cands[i].vertexNdof()),
+				unsigned(cands[i].daughter(0)->get<reco::TrackRef>().key()), unsigned(cands[i].daughter(1)->get<reco::TrackRef>().key()), 1};
+		}
+		return entries;
+	}
+
+	std::vector<CapEntry> capEntries(const QWD0CompactCandidates & rows) {
+		std::vector<CapEntry> entries(rows.size());
+		for (unsigned i = 0; i < rows.size(); ++i) {
+			const QWD0FittedPair & pair = rows.pair(i);
+			unsigned bits = rows.assignments(i);
+			entries[i] = CapEntry{pairProb(pair.chi2(), pair.ndof()), pair.key1(), pair.key2(),
+				unsigned(bool(bits & QWD0CompactCandidates::kFirstIsMass1)) + unsigned(bool(bits & QWD0CompactCandidates::kSecondIsMass1))};
+		}
+		return entries;
+	}
+
+	// the entries by decreasing probability, ties in their order; the
+	// candidates of a pair stay next to each other
+	std::vector<unsigned> rankEntries(const std::vector<CapEntry> & entries) {
+		std::vector<unsigned> order(entries.size());
+		for (unsigned i = 0; i < order.size(); ++i) order[i] = i;
+		std::stable_sort(order.begin(), order.end(), [&entries](unsigned a, unsigned b) { return entries[a].prob > entries[b].prob; });
+		return order;
+	}
+
+	// going down in probability, keep the candidates whose daughter tracks
+	// are both still in fewer than maxPerTrack kept candidates
+	void keepPerTrack(std::vector<CapEntry> & entries, unsigned maxPerTrack) {
+		unsigned maxKey = 0;
+		for (const CapEntry & entry : entries) maxKey = std::max(maxKey, std::max(entry.key1, entry.key2));
+		std::vector<unsigned> uses(maxKey + 1, 0);
+		for (unsigned i : rankEntries(entries)) {
+			CapEntry & entry = entries[i];
+			unsigned kept = 0;
+			while (kept < entry.nCandidates && uses[entry.key1] < maxPerTrack && uses[entry.key2] < maxPerTrack) {
+				++uses[entry.key1];
+				++uses[entry.key2];
+				++kept;
+			}
+			entry.nCandidates = kept;
+		}
+	}
+
+	// keep the maxCandidates candidates of highest probability; ties go to
+	// the earlier candidate, so pruning parts of the serial order first
+	// keeps the same ones
+	void keepBest(std::vector<CapEntry> & entries, unsigned maxCandidates) {
+		unsigned left = maxCandidates;
+		for (unsigned i : rankEntries(entries)) {
+			entries[i].nCandidates = std::min(entries[i].nCandidates, left);
+			left -= entries[i].nCandidates;
+		}
+	}
+
+	// keep the candidates of the entries left, in their order, and their
+	// variables; the variables that are not stored are empty
+	void keepEntries(reco::VertexCompositeCandidateCollection & cands, std::vector<std::vector<float>> & variables, const std::vector<CapEntry> & entries) {
+		unsigned n = 0;
+		for (unsigned i = 0; i < cands.size(); ++i) {
+			if (entries[i].nCandidates == 0) continue;
+			// n <= i, the sources are not written over before they move
+			if (n != i) {
+				cands[n] = std::move(cands[i]);
+				for (std::vector<float> & values : variables) {
+					if (!values.empty()) values[n] = values[i];
+				}
+			}
+			++n;
+		}
+		cands.erase(cands.begin() + n, cands.end());
+		for (std::vector<float> & values : variables) {
+			if (!values.empty()) values.resize(n);
+		}
+	}
+
+	void keepEntries(QWD0CompactCandidates & rows, const std::vector<CapEntry> & entries) {
+		std::vector<unsigned> counts(entries.size());
+		for (unsigned i = 0; i < entries.size(); ++i) counts[i] = entries[i].nCandidates;
+		rows.keepCandidates(counts);
+	}
+
+	// keep the fitted pairs of the kept entries, in their order
+	void keepPairs(QWD0FittedPairCollection & pairs, std::vector<std::pair<unsigned, unsigned>> & keys) {
+		std::sort(keys.begin(), keys.end());
+		unsigned n = 0;
+		for (unsigned i = 0; i < pairs.size(); ++i) {
+			if (!std::binary_search(keys.begin(), keys.end(), std::make_pair(pairs[i].key1(), pairs[i].key2()))) continue;
+			if (n != i) pairs[n] = pairs[i];
+			++n;
+		}
+		pairs.resize(n);
+	}
+
+	// vertexFitter is 'kalman', 'adaptive', 'analyticKalman' or 'analyticAdaptive',
+	// or true (kalman) / false (adaptive) in older configurations
+	void vertexFitterMode(const edm::ParameterSet & theParameters, bool & kalman, bool & analytic) {
+		if (theParameters.existsAs<bool>("vertexFitter")) {
+			kalman = theParameters.getParameter<bool>("vertexFitter");
+			analytic = false;
+			return;
+		}
+		std::string fitter = theParameters.getParameter<std::string>("vertexFitter");
+		analytic = fitter.compare(0, 8, "analytic") == 0;
+		if (analytic) fitter = fitter.substr(8);
+		if (fitter == "kalman" || fitter == "Kalman") {
+			kalman = true;
+		} else if (fitter == "adaptive" || fitter == "Adaptive") {
+			kalman = false;
+		} else {
+			throw cms::Exception("Configuration") << "QWD0Fitter: unknown vertexFitter '" << theParameters.getParameter<std::string>("vertexFitter")
+				<< "', use 'kalman', 'adaptive', 'analyticKalman' or 'analyticAdaptive'";
+		}
+	}
+
+	// the fitter is set up once per workspace and reused for every pair
+	VertexFitter<5> * makeVertexFitter(const edm::ParameterSet & theParameters) {
+		bool kalman, analytic;
+		vertexFitterMode(theParameters, kalman, analytic);
+		if (kalman) {
+			return new KalmanVertexFitter(theParameters.getParameter<bool>("useRefTracks"));
+		}
+		return new AdaptiveVertexFitter();
+	}
+
+	// Transverse vertex estimate of two tracks crossing at cxPt: each track
+	// constrains the position perpendicular to its direction with the error
+	// of its transverse impact parameter w.r.t. cxPt. Returns false if the
+	// tracks are too parallel (or the errors missing) for an estimate.
+	bool analyticVertexXY(const TrajectoryStateClosestToPoint & TSCP1, const TrajectoryStateClosestToPoint & TSCP2,
+			const GlobalPoint & cxPt, const math::XYZPoint & referencePos, const SMatrixSym3D & referenceCov,
+			double & sigXY, double & angleXY, double & sigmaAngleXY)
+	{
+		if (!TSCP1.hasError() || !TSCP2.hasError()) return false;
+		double phi1 = TSCP1.momentum().phi();
+		double phi2 = TSCP2.momentum().phi();
+		double w1 = 1./(TSCP1.perigeeError().transverseImpactParameterError()*TSCP1.perigeeError().transverseImpactParameterError());
+		double w2 = 1./(TSCP2.perigeeError().transverseImpactParameterError()*TSCP2.perigeeError().transverseImpactParameterError());
+		if (!std::isfinite(w1) || !std::isfinite(w2)) return false;
+
+		// information matrix sum(w n n^T) with n = (-sin phi, cos phi)
+		double i11 = w1*sin(phi1)*sin(phi1) + w2*sin(phi2)*sin(phi2);
+		double i12 = -w1*sin(phi1)*cos(phi1) - w2*sin(phi2)*cos(phi2);
+		double i22 = w1*cos(phi1)*cos(phi1) + w2*cos(phi2)*cos(phi2);
+		double det = i11*i22 - i12*i12;
+		if (!(det > 0.)) return false;
+		double c11 = i22/det + referenceCov(0, 0);
+		double c12 = -i12/det + referenceCov(0, 1);
+		double c22 = i11/det + referenceCov(1, 1);
+
+		double dx = cxPt.x() - referencePos.x();
+		double dy = cxPt.y() - referencePos.y();
+		double dist = sqrt(dx*dx + dy*dy);
+		if (!(dist > 0.)) return false;
+		double sigmaDist = sqrt((dx*dx*c11 + 2.*dx*dy*c12 + dy*dy*c22)) / dist;
+		double sigmaPerp = sqrt((dy*dy*c11 - 2.*dx*dy*c12 + dx*dx*c22)) / dist;
+		sigXY = dist/sigmaDist;
+
+		GlobalVector totalP = TSCP1.momentum() + TSCP2.momentum();
+		double pt = totalP.perp();
+		if (!(pt > 0.)) return false;
+		angleXY = (dx*totalP.x() + dy*totalP.y())/(dist*pt);
+
+		// direction error of the summed transverse momentum
+		double phi = totalP.phi();
+		double dPhi1 = TSCP1.momentum().perp()*cos(phi1 - phi)/pt;
+		double dPhi2 = TSCP2.momentum().perp()*cos(phi2 - phi)/pt;
+		double sigmaPhi2 = dPhi1*dPhi1*TSCP1.perigeeError().covarianceMatrix()(1, 1) + dPhi2*dPhi2*TSCP2.perigeeError().covarianceMatrix()(1, 1);
+		sigmaAngleXY = sqrt(sigmaPerp*sigmaPerp/(dist*dist) + sigmaPhi2);
+		return true;
+	}
+}
+
+QWD0Fitter::LoopWorkspace::LoopWorkspace(VertexFitter<5> * theFitter, bool fillHistograms, bool timing) :
+	fitter(theFitter),
+	fitTracks(2),
+	nPairs(0),
+	nFits(0),
+	monitor(fillHistograms, timing)
+{
+}
+
+QWD0Fitter::Workspace::Workspace(const QWD0Fitter & fitter) :
+	pairFinder(fitter.thePairFinder),
+	zWindow(fitter.theZWindow),
+	magneticField(nullptr),
+	beamSpotX0(0.),
+	beamSpotY0(0.),
+	beamSpotZ0(0.),
+	nVertexFits(0),
+	pairsPerCombination(-1.),
+	loop(fitter.theVertexFitter->clone(), fitter.monitorHistograms_, fitter.monitorTiming_ || fitter.storeStageTimes_),
+	taskLoops([&fitter] () {
+		return LoopWorkspace(fitter.theVertexFitter->clone(), fitter.monitorHistograms_, fitter.monitorTiming_ || fitter.storeStageTimes_);
+	})
+{
+}
+
+QWD0Fitter::QWD0Fitter(const edm::ParameterSet& theParameters, edm::ConsumesCollector && iC) :
+	theVertexFitter(makeVertexFitter(theParameters)),
+	monitorHistograms_(theParameters.getUntrackedParameter<bool>("monitorHistograms", false)),
+	monitorTiming_(theParameters.getUntrackedParameter<bool>("monitorTiming", false)),
+	storeStageTimes_(theParameters.getParameter<bool>("storeStageTimes")),
+	thePairFinder(120.)
+{
+	token_beamSpot = iC.consumes<reco::BeamSpot>(theParameters.getParameter<edm::InputTag>("beamSpot"));
+	useVertex_ = theParameters.getParameter<bool>("useVertex");
+	std::string vertexAssociation = theParameters.getParameter<std::string>("vertexAssociation");
+	if (vertexAssociation == "leading") {
+		vertexAssociation_ = kLeadingVertex;
+	} else if (vertexAssociation == "dz") {
+		vertexAssociation_ = kDzVertex;
+	} else if (vertexAssociation == "pointing") {
+		vertexAssociation_ = kPointingVertex;
+	} else {
+		throw cms::Exception("Configuration") << "QWD0Fitter: unknown vertexAssociation '" << vertexAssociation
+			<< "', expected 'leading', 'dz' or 'pointing'";
+	}
+	vertexAssociationMaxDz_ = theParameters.getParameter<double>("vertexAssociationMaxDz");
+	token_vertices = iC.consumes<std::vector<reco::Vertex>>(theParameters.getParameter<edm::InputTag>("vertices"));
+
+	token_tracks = iC.consumes<reco::TrackCollection>(theParameters.getParameter<edm::InputTag>("trackRecoAlgorithm"));
+	vertexFitterMode(theParameters, vertexFitter_, analyticPrefit_);
+	analyticVertexMargin_ = theParameters.getParameter<double>("analyticVertexMargin");
+	useRefTracks_ = theParameters.getParameter<bool>("useRefTracks");
+
+	// the AdaptiveVertexFitter does not return refitted tracks
+	if (!vertexFitter_) useRefTracks_ = false;
+
+	std::string pairFinder = theParameters.getParameter<std::string>("pairFinder");
+	if (pairFinder == "bruteForce") {
+		bruteForcePairs_ = true;
+	} else if (pairFinder == "binned") {
+		bruteForcePairs_ = false;
+	} else {
+		throw cms::Exception("Configuration") << "QWD0Fitter: unknown pairFinder '" << pairFinder << "', use 'binned' or 'bruteForce'";
+	}
+	std::string charges = theParameters.getParameter<std::string>("chargeCombination");
+	if (charges == "opposite") {
+		thePairFinder.setChargeCombination(QWD0PairFinder::kOppositeSign);
+	} else if (charges == "same") {
+		thePairFinder.setChargeCombination(QWD0PairFinder::kSameSign);
+	} else if (charges == "both") {
+		thePairFinder.setChargeCombination(QWD0PairFinder::kBothSigns);
+	} else {
+		throw cms::Exception("Configuration") << "QWD0Fitter: unknown chargeCombination '" << charges << "', use 'opposite', 'same' or 'both'";
+	}
+	theZWindow.setMaxSignificance(theParameters.getParameter<double>("pairMaxDzSignificance"));
+	pairPrefilter_ = theParameters.getParameter<bool>("pairPrefilter");
+	std::string pairPrefilterKernel = theParameters.getParameter<std::string>("pairPrefilterKernel");
+	if (pairPrefilterKernel == "scalar") {
+		thePairFilter.setKernel(QWD0PairFilter::kScalarKernel);
+	} else if (pairPrefilterKernel == "avx2") {
+		thePairFilter.setKernel(QWD0PairFilter::kAVX2Kernel);
+	} else if (pairPrefilterKernel == "avx512") {
+		thePairFilter.setKernel(QWD0PairFilter::kAVX512Kernel);
+	} else if (pairPrefilterKernel != "auto") {
+		throw cms::Exception("Configuration") << "QWD0Fitter: unknown pairPrefilterKernel '" << pairPrefilterKernel << "', use 'auto', 'scalar', 'avx2' or 'avx512'";
+	}
+	storeFittedPairs_ = theParameters.getParameter<bool>("storeFittedPairs");
+	storeVariables_ = theParameters.getParameter<bool>("storeVariables");
+	std::string outputFormat = theParameters.getParameter<std::string>("outputFormat");
+	if (outputFormat == "candidates") {
+		storeCandidates_ = true;
+		storeCompactCandidates_ = false;
+	} else if (outputFormat == "compact") {
+		storeCandidates_ = false;
+		storeCompactCandidates_ = true;
+	} else if (outputFormat == "both") {
+		storeCandidates_ = true;
+		storeCompactCandidates_ = true;
+	} else {
+		throw cms::Exception("Configuration") << "QWD0Fitter: unknown outputFormat '" << outputFormat
+			<< "', expected 'candidates', 'compact' or 'both'";
+	}
+	parallelMinTracks_ = theParameters.getParameter<unsigned>("parallelMinTracks");
+	parallelChunkSize_ = theParameters.getParameter<unsigned>("parallelChunkSize");
+	if (parallelChunkSize_ == 0) {
+		throw cms::Exception("Configuration") << "QWD0Fitter: parallelChunkSize has to be > 0";
+	}
+
+	// cuts on initial track selection
+	tkChi2Cut_ = theParameters.getParameter<double>("tkChi2Cut");
+	tkNHitsCut_ = theParameters.getParameter<int>("tkNHitsCut");
+	tkPtCut_ = theParameters.getParameter<double>("tkPtCut");
+	tkIPSigXYCut_ = theParameters.getParameter<double>("tkIPSigXYCut");
+	tkIPSigZCut_ = theParameters.getParameter<double>("tkIPSigZCut");
+
+	// cuts on vertex
+	vtxChi2Cut_ = theParameters.getParameter<double>("vtxChi2Cut");
+	vtxDecaySigXYZCut_ = theParameters.getParameter<double>("vtxDecaySigXYZCut");
+	vtxDecaySigXYCut_ = theParameters.getParameter<double>("vtxDecaySigXYCut");
+	vtxProb_ = theParameters.getParameter<double>("vtxProb");
+	// miscellaneous cuts
+	tkDCACut_ = theParameters.getParameter<double>("tkDCACut");
+	mPiPiCut_ = theParameters.getParameter<double>("mPiPiCut");
+	innerHitPosCut_ = theParameters.getParameter<double>("innerHitPosCut");
+	cosThetaXYCut_ = theParameters.getParameter<double>("cosThetaXYCut");
+	cosThetaXYZCut_ = theParameters.getParameter<double>("cosThetaXYZCut");
+	prefitD0MassTolerance_ = theParameters.getParameter<double>("prefitD0MassTolerance");
+
+	// optional cuts
+	applyTkDCACut_ = theParameters.getParameter<bool>("applyTkDCACut");
+	applyMPiPiCut_ = theParameters.getParameter<bool>("applyMPiPiCut");
+	applyPrefitD0MassCut_ = theParameters.getParameter<bool>("applyPrefitD0MassCut");
+	applyVtxDecaySigXYCut_ = theParameters.getParameter<bool>("applyVtxDecaySigXYCut");
+	applyVtxDecaySigXYZCut_ = theParameters.getParameter<bool>("applyVtxDecaySigXYZCut");
+	applyInnerHitPosCut_ = theParameters.getParameter<bool>("applyInnerHitPosCut");
+	applyCosThetaXYZCut_ = theParameters.getParameter<bool>("applyCosThetaXYZCut");
+
+	// tighter track cuts above a number of preselected tracks, each step at
+	// least as tight as the preselection and the steps below it
+	for (const edm::ParameterSet & pset : theParameters.getParameter<std::vector<edm::ParameterSet>>("multiplicitySteps")) {
+		MultiplicityStep step;
+		step.minTracks = pset.getParameter<unsigned>("minTracks");
+		step.tkPtCut = pset.getParameter<double>("tkPtCut");
+		step.tkIPSigXYCut = pset.getParameter<double>("tkIPSigXYCut");
+		theMultiplicitySteps.push_back(step);
+	}
+	std::sort(theMultiplicitySteps.begin(), theMultiplicitySteps.end(),
+			[](const MultiplicityStep & a, const MultiplicityStep & b) { return a.minTracks < b.minTracks; });
+	double stepPtCut = tkPtCut_, stepIPSigXYCut = tkIPSigXYCut_;
+	for (MultiplicityStep & step : theMultiplicitySteps) {
+		step.tkPtCut = stepPtCut = std::max(stepPtCut, step.tkPtCut);
+		step.tkIPSigXYCut = stepIPSigXYCut = std::max(stepIPSigXYCut, step.tkIPSigXYCut);
+	}
+	maxVertexFits_ = theParameters.getParameter<unsigned>("maxVertexFits");
+	// claiming the budget first-come in the tasks would make the output
+	// depend on the scheduling
+	if (maxVertexFits_ > 0 && parallelMinTracks_ > 0) {
+		throw cms::Exception("Configuration") << "QWD0Fitter: maxVertexFits needs the serial pair loop, set parallelMinTracks to 0";
+	}
+	maxCandidates_ = theParameters.getParameter<unsigned>("maxCandidates");
+	maxCandidatesPerTrack_ = theParameters.getParameter<unsigned>("maxCandidatesPerTrack");
+	std::string massAssignment = theParameters.getParameter<std::string>("massAssignment");
+	if (massAssignment == "both") {
+		massAssignment_ = kBothAssignments;
+	} else if (massAssignment == "closest") {
+		massAssignment_ = kClosestAssignment;
+	} else if (massAssignment == "single") {
+		// the other mass goes into the swappedMass ValueMap
+		massAssignment_ = kSingleAssignment;
+	} else {
+		throw cms::Exception("Configuration") << "QWD0Fitter: unknown massAssignment '" << massAssignment
+			<< "', expected 'both', 'closest' or 'single'";
+	}
+
+	// the D0 from the top-level cuts
+	Hypothesis d0;
+	d0.label = "";
+	d0.mass1 = piMass;
+	d0.mass2 = kaonMass;
+	d0.mass = D0Mass;
+	d0.massWindow = theParameters.getParameter<double>("D0MassCut");
+	d0.pdgId = 421;
+	d0.sameSignPdgId = 81;
+	d0.chargeConjugate = true;
+	d0.vtxDecaySigXYCut = vtxDecaySigXYCut_;
+	d0.vtxDecaySigXYZCut = vtxDecaySigXYZCut_;
+	d0.cosThetaXYCut = cosThetaXYCut_;
+	d0.cosThetaXYZCut = cosThetaXYZCut_;
+	d0.applyVtxDecaySigXYCut = applyVtxDecaySigXYCut_;
+	d0.applyVtxDecaySigXYZCut = applyVtxDecaySigXYZCut_;
+	d0.applyCosThetaXYZCut = applyCosThetaXYZCut_;
+	theHypotheses.push_back(d0);
+
+	// further two-body decays on the same pairs, their cuts default to the D0 ones
+	std::vector<edm::ParameterSet> extraHypotheses;
+	if (theParameters.existsAs<std::vector<edm::ParameterSet>>("extraHypotheses")) {
+		extraHypotheses = theParameters.getParameter<std::vector<edm::ParameterSet>>("extraHypotheses");
+	}
+	for (const edm::ParameterSet & pset : extraHypotheses) {
+		Hypothesis hyp = d0;
+		hyp.label = pset.getParameter<std::string>("label");
+		for (const Hypothesis & other : theHypotheses) {
+			if (hyp.label == other.label) {
+				throw cms::Exception("Configuration") << "QWD0Fitter: extraHypotheses need distinct, non-empty labels, got '" << hyp.label << "'";
+			}
+		}
+		hyp.mass1 = pset.getParameter<double>("mass1");
+		hyp.mass2 = pset.getParameter<double>("mass2");
+		hyp.mass = pset.getParameter<double>("mass");
+		hyp.massWindow = pset.getParameter<double>("massWindow");
+		hyp.pdgId = pset.getParameter<int>("pdgId");
+		hyp.sameSignPdgId = pset.exists("sameSignPdgId") ? pset.getParameter<int>("sameSignPdgId") : 0;
+		hyp.chargeConjugate = pset.exists("chargeConjugate") ? pset.getParameter<bool>("chargeConjugate") : true;
+		if (pset.exists("vtxDecaySigXYCut")) hyp.vtxDecaySigXYCut = pset.getParameter<double>("vtxDecaySigXYCut");
+		if (pset.exists("vtxDecaySigXYZCut")) hyp.vtxDecaySigXYZCut = pset.getParameter<double>("vtxDecaySigXYZCut");
+		if (pset.exists("cosThetaXYCut")) hyp.cosThetaXYCut = pset.getParameter<double>("cosThetaXYCut");
+		if (pset.exists("cosThetaXYZCut")) hyp.cosThetaXYZCut = pset.getParameter<double>("cosThetaXYZCut");
+		if (pset.exists("applyVtxDecaySigXYCut")) hyp.applyVtxDecaySigXYCut = pset.getParameter<bool>("applyVtxDecaySigXYCut");
+		if (pset.exists("applyVtxDecaySigXYZCut")) hyp.applyVtxDecaySigXYZCut = pset.getParameter<bool>("applyVtxDecaySigXYZCut");
+		if (pset.exists("applyCosThetaXYZCut")) hyp.applyCosThetaXYZCut = pset.getParameter<bool>("applyCosThetaXYZCut");
+		theHypotheses.push_back(hyp);
+	}
+
+	// the pairs only have to pass the loosest cuts of all hypotheses
+	for (const Hypothesis & hyp : theHypotheses) {
+		applyVtxDecaySigXYCut_ = applyVtxDecaySigXYCut_ && hyp.applyVtxDecaySigXYCut;
+		applyVtxDecaySigXYZCut_ = applyVtxDecaySigXYZCut_ && hyp.applyVtxDecaySigXYZCut;
+		applyCosThetaXYZCut_ = applyCosThetaXYZCut_ && hyp.applyCosThetaXYZCut;
+		vtxDecaySigXYCut_ = std::min(vtxDecaySigXYCut_, hyp.vtxDecaySigXYCut);
+		vtxDecaySigXYZCut_ = std::min(vtxDecaySigXYZCut_, hyp.vtxDecaySigXYZCut);
+		cosThetaXYCut_ = std::min(cosThetaXYCut_, hyp.cosThetaXYCut);
+		cosThetaXYZCut_ = std::min(cosThetaXYZCut_, hyp.cosThetaXYZCut);
+	}
+
+	thePairFinder.setMaxDCA(applyTkDCACut_ ? tkDCACut_ : -1.);
+	thePairFilter.setMPiPiCut(applyMPiPiCut_ ? mPiPiCut_ : -1.);
+	if (applyPrefitD0MassCut_) {
+		for (const Hypothesis & hyp : theHypotheses) {
+			thePairFilter.addMassWindow(hyp.mass1, hyp.mass2, hyp.mass, hyp.massWindow + prefitD0MassTolerance_);
+			if (hyp.mass1 != hyp.mass2) thePairFilter.addMassWindow(hyp.mass2, hyp.mass1, hyp.mass, hyp.massWindow + prefitD0MassTolerance_);
+		}
+	}
+	LogDebug("QWD0Fitter") << "pair prefilter kernel: " << QWD0PairFilter::kernelName(thePairFilter.kernel());
+}
+
+const char * QWD0Fitter::variableName(Variable var)
+{
+	static const char * const names[nVariables] = {
+		"dca",
+		"mPiPi",
+		"decaySigXY",
+		"decaySigXYZ",
+		"cosThetaXY",
+		"cosThetaXYZ",
+		"swappedMass"
+	};
+	return var < nVariables ? names[var] : "";
+}
+
+std::vector<std::string> QWD0Fitter::hypothesisLabels() const
+{
+	std::vector<std::string> labels;
+	for (const Hypothesis & hyp : theHypotheses) labels.push_back(hyp.label);
+	return labels;
+}
+
+std::unique_ptr<QWD0Fitter::Workspace> QWD0Fitter::makeWorkspace() const
+{
+	return std::unique_ptr<Workspace>(new Workspace(*this));
+}
+
+// method containing the algorithm for vertex reconstruction
+// the candidates and compact rows of each hypothesis are ranked and cut the
+// same way, the fitted pairs kept are the ones of the candidates kept
+void QWD0Fitter::capOutput(Output & output) const
+{
+	std::vector<std::pair<unsigned, unsigned>> keptPairs;
+	auto keepCaps = [&](std::vector<CapEntry> & entries) {
+		if (maxCandidatesPerTrack_ > 0) keepPerTrack(entries, maxCandidatesPerTrack_);
+		if (maxCandidates_ > 0) keepBest(entries, maxCandidates_);
+		for (const CapEntry & entry : entries) {
+			if (storeFittedPairs_ && entry.nCandidates > 0) keptPairs.emplace_back(entry.key1, entry.key2);
+		}
+	};
+	for (unsigned ihyp = 0; ihyp < theHypotheses.size(); ++ihyp) {
+		if (storeCandidates_) {
+			std::vector<CapEntry> entries = capEntries(output.candidates[ihyp]);
+			keepCaps(entries);
+			keepEntries(output.candidates[ihyp], output.variables[ihyp], entries);
+		}
+		if (storeCompactCandidates_) {
+			std::vector<CapEntry> entries = capEntries(output.compactCandidates[ihyp]);
+			keepCaps(entries);
+			keepEntries(output.compactCandidates[ihyp], entries);
+		}
+	}
+	if (storeFittedPairs_) keepPairs(output.fittedPairs, keptPairs);
+}
+
+void QWD0Fitter::fitAll(const edm::Event& iEvent, const edm::EventSetup& iSetup, Workspace & workspace, Output & output) const
+{
+	using std::vector;
+
+	QWD0TrackCache & theTracks = workspace.tracks;
+	QWD0VertexIndex & theVertexIndex = workspace.vertexIndex;
+	LoopWorkspace & theLoop = workspace.loop;
+
+	output.candidates.resize(theHypotheses.size());
+	output.compactCandidates.resize(theHypotheses.size());
+	output.variables.assign(theHypotheses.size(), std::vector<std::vector<float>>(storeAnyVariable() ? nVariables : 0));
+	for (unsigned ihyp = 0; ihyp < theHypotheses.size(); ++ihyp) {
+		const Hypothesis & hyp = theHypotheses[ihyp];
+		output.compactCandidates[ihyp].setHypothesis(hyp.mass1, hyp.mass2, hyp.pdgId, hyp.sameSignPdgId, hyp.chargeConjugate);
+	}
+
+	edm::Handle<reco::TrackCollection> theTrackHandle;
+	iEvent.getByToken(token_tracks, theTrackHandle);
+	const reco::TrackCollection* theTrackCollection = theTrackHandle.product();
+
+	edm::Handle<reco::BeamSpot> theBeamSpotHandle;
+	iEvent.getByToken(token_beamSpot, theBeamSpotHandle);
+	const reco::BeamSpot* theBeamSpot = theBeamSpotHandle.product();
+
+	// the tracks and pairs are measured from a primary vertex, or from the
+	// beamspot if there is none to associate them with
+	edm::Handle<std::vector<reco::Vertex>> vertices;
+	theVertexIndex.clear();
+	if (useVertex_) {
+		iEvent.getByToken(token_vertices, vertices);
+		if (vertexAssociation_ != kLeadingVertex) theVertexIndex.build(*vertices);
+	}
+	// the reference vertex for a z at the beam line, -1 for the beamspot
+	auto associateVertex = [&](double z) -> int {
+		if (!useVertex_) return -1;
+		if (vertexAssociation_ == kLeadingVertex) return vertices->empty() ? -1 : 0;
+		return theVertexIndex.nearest(z, vertexAssociationMaxDz_);
+	};
+	auto referencePosition = [&](int ivtx) -> math::XYZPoint {
+		return ivtx < 0 ? theBeamSpot->position() : (*vertices)[ivtx].position();
+	};
+
+	// the beamspot covariance is only rotated again in a new luminosity
+	// block or for a different beamspot, the vertex covariances are unpacked
+	// once per event instead of for every pair
+	edm::LuminosityBlockID lumi(iEvent.id().run(), iEvent.luminosityBlock());
+	if (workspace.referenceCovariances.empty() || lumi != workspace.beamSpotLumi ||
+			theBeamSpot->x0() != workspace.beamSpotX0 || theBeamSpot->y0() != workspace.beamSpotY0 || theBeamSpot->z0() != workspace.beamSpotZ0) {
+		workspace.beamSpotLumi = lumi;
+		workspace.beamSpotX0 = theBeamSpot->x0();
+		workspace.beamSpotY0 = theBeamSpot->y0();
+		workspace.beamSpotZ0 = theBeamSpot->z0();
+		workspace.referenceCovariances.assign(1, theBeamSpot->rotatedCovariance3D());
+	}
+	workspace.referenceCovariances.resize(1);
+	for (unsigned ivtx = 0; useVertex_ && ivtx < vertices->size(); ++ivtx) {
+		workspace.referenceCovariances.push_back((*vertices)[ivtx].covariance());
+		if (vertexAssociation_ == kLeadingVertex) break;
+	}
+	auto referenceCovariance = [&](int ivtx) -> const SMatrixSym3D & {
+		return workspace.referenceCovariances[ivtx + 1];
+	};
+
+	// the field is only looked up again in a new IOV
+	if (workspace.fieldWatcher.check(iSetup) || !workspace.magneticField) {
+		edm::ESHandle<MagneticField> theMagneticFieldHandle;
+		iSetup.get<IdealMagneticFieldRecord>().get(theMagneticFieldHandle);
+		workspace.magneticField = theMagneticFieldHandle.product();
+	}
+	const MagneticField* theMagneticField = workspace.magneticField;
+
+	// the stage times before the event, the monitor sums over the events
+	const auto eventStart = storeStageTimes_ ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+	std::vector<unsigned long long> startNanoseconds, startCalls;
+	for (unsigned stage = 0; storeStageTimes_ && stage < QWD0Monitor::nStages; ++stage) {
+		startNanoseconds.push_back(theLoop.monitor.nanoseconds(QWD0Monitor::Stage(stage)));
+		startCalls.push_back(theLoop.monitor.calls(QWD0Monitor::Stage(stage)));
+	}
+
+	QWD0Monitor::StageTimer stageTimer(theLoop.monitor);
+	stageTimer.start(QWD0Monitor::kPreselectionStage);
+
+	theTracks.clear();
+
+	// apply the preselection cuts, then the tighter cuts of the highest
+	// multiplicity step the event reaches, and fill the track cache. The
+	// cheap cuts run first as a branch-free mask over flat arrays, the impact
+	// parameters are only computed for the tracks passing them.
+	const size_t nTracks = theTrackCollection->size();
+	workspace.trackPt.resize(nTracks);
+	workspace.trackChi2.resize(nTracks);
+	workspace.trackNHits.resize(nTracks);
+	workspace.trackMask.resize(nTracks);
+	for (size_t itk = 0; itk < nTracks; ++itk) {
+		const reco::Track & track = (*theTrackCollection)[itk];
+		workspace.trackPt[itk] = track.pt();
+		workspace.trackChi2[itk] = track.normalizedChi2();
+		workspace.trackNHits[itk] = track.numberOfValidHits();
+	}
+	{
+		const double * pt = workspace.trackPt.data();
+		const double * chi2 = workspace.trackChi2.data();
+		const int * nHits = workspace.trackNHits.data();
+		unsigned char * mask = workspace.trackMask.data();
+		for (size_t itk = 0; itk < nTracks; ++itk) {
+			mask[itk] = (chi2[itk] < tkChi2Cut_) & (nHits[itk] >= tkNHitsCut_) & (pt[itk] > tkPtCut_);
+		}
+	}
+	workspace.trackIndices.clear();
+	for (size_t itk = 0; itk < nTracks; ++itk) {
+		if (workspace.trackMask[itk]) workspace.trackIndices.push_back(itk);
+	}
+
+	workspace.preselected.clear();
+	for (unsigned itk : workspace.trackIndices) {
+		const reco::Track & track = (*theTrackCollection)[itk];
+		double zBeam = theBeamSpot->position().z() + track.dz(theBeamSpot->position());
+		int ivtx = associateVertex(zBeam);
+		math::XYZPoint referencePos = referencePosition(ivtx);
+		double ipsigXY = ivtx >= 0 ? std::abs(track.dxy(referencePos)/track.dxyError()) : std::abs(track.dxy(*theBeamSpot)/track.dxyError());
+		if (!(ipsigXY > tkIPSigXYCut_)) continue;
+		double ipsigZ = std::abs(track.dz(referencePos)/track.dzError());
+		if (!(ipsigZ > tkIPSigZCut_)) continue;
+		PreselectedTrack preselected = {itk, float(ipsigXY), float(ipsigZ), float(zBeam)};
+		workspace.preselected.push_back(preselected);
+	}
+
+	int step = -1;
+	for (unsigned istep = 0; istep < theMultiplicitySteps.size(); ++istep) {
+		if (workspace.preselected.size() >= theMultiplicitySteps[istep].minTracks) step = istep;
+	}
+	double tkPtCut = step < 0 ? tkPtCut_ : theMultiplicitySteps[step].tkPtCut;
+	double tkIPSigXYCut = step < 0 ? tkIPSigXYCut_ : theMultiplicitySteps[step].tkIPSigXYCut;
+	output.throttle = QWD0ThrottleInfo(workspace.preselected.size(), step, tkPtCut, tkIPSigXYCut);
+	if (step >= 0 && qwd0::tracePairs) edm::LogVerbatim("QWD0Fitter") << workspace.preselected.size() << " preselected tracks, tkPtCut "
+		<< tkPtCut << " tkIPSigXYCut " << tkIPSigXYCut;
+
+	// the TransientTracks are built in one batch into the reserved cache
+	theTracks.reserve(workspace.preselected.size());
+	for (const PreselectedTrack & preselected : workspace.preselected) {
+		reco::TrackRef tmpRef(theTrackHandle, preselected.key);
+		if (step >= 0 && !(tmpRef->pt() > tkPtCut && preselected.ipSigXY > tkIPSigXYCut)) continue;
+		theTracks.push_back(tmpRef, reco::TransientTrack(*tmpRef, theMagneticField), preselected.ipSigXY, preselected.ipSigZ, preselected.zBeam);
+	}
+	// good tracks have now been selected for vertexing
+	theLoop.monitor.countEvent(theTrackCollection->size(), theTracks.size());
+	if (pairPrefilter_ || !bruteForcePairs_) theTracks.computeTurnBounds(120.);
+	stageTimer.stop();
+
+	// vertex a pair of good charged tracks
+	auto fitPair = [&](LoopWorkspace & ws, unsigned int trdx1, unsigned int trdx2, Output & out) {
+		const reco::TrackRef & TrackRef1 = theTracks.refs[trdx1];
+		const reco::TrackRef & TrackRef2 = theTracks.refs[trdx2];
+		const reco::TransientTrack* TransTkPtr1 = &theTracks.transientTracks[trdx1];
+		const reco::TransientTrack* TransTkPtr2 = &theTracks.transientTracks[trdx2];
+		ws.monitor.countPair();
+		++ws.nPairs;
+		QWD0Monitor::StageTimer pairTimer(ws.monitor);
+
+		int charge1 = theTracks.charge[trdx1];
+		int charge2 = theTracks.charge[trdx2];
+		if (charge1 == 0 or charge2 == 0) {
+			ws.monitor.reject(QWD0Monitor::kCharge);
+			return;
+		}
+
+		// measure distance between tracks at their closest approach
+		pairTimer.start(QWD0Monitor::kClosestApproachStage);
+		if (!theTracks.valid[trdx1] || !theTracks.valid[trdx2]) {
+			if (qwd0::tracePairs) edm::LogVerbatim("QWD0Fitter") << "pair " << trdx1 << " " << trdx2 << ": impactPointTSCP failed";
+			ws.monitor.reject(QWD0Monitor::kImpactPointTSCP);
+			return;
+		}
+		FreeTrajectoryState const & State1 = theTracks.states[trdx1];
+		FreeTrajectoryState const & State2 = theTracks.states[trdx2];
+		ClosestApproachInRPhi cApp;
+		cApp.calculate(State1, State2);
+		if (!cApp.status()) {
+			if (qwd0::tracePairs) edm::LogVerbatim("QWD0Fitter") << "pair " << trdx1 << " " << trdx2 << ": ClosestApproachInRPhi failed";
+			ws.monitor.reject(QWD0Monitor::kClosestApproach);
+			return;
+		}
+		float dca = std::abs(cApp.distance());
+		ws.monitor.fill(QWD0Monitor::kDCAValue, dca);
+		if (qwd0::tracePairs) edm::LogVerbatim("QWD0Fitter") << "pair " << trdx1 << " " << trdx2 << ": dca = " << dca;
+		if (applyTkDCACut_ && dca > tkDCACut_) {
+			ws.monitor.reject(QWD0Monitor::kDCA);
+			return;
+		}
+		// the POCA should at least be in the sensitive volume
+		GlobalPoint cxPt = cApp.crossingPoint();
+		if (sqrt(cxPt.x()*cxPt.x() + cxPt.y()*cxPt.y()) > 120. || std::abs(cxPt.z()) > 300.) {
+			ws.monitor.reject(QWD0Monitor::kFiducial);
+			return;
+		}
+
+		// the tracks should at least point in the same quadrant
+		pairTimer.start(QWD0Monitor::kCrossingTSCPStage);
+		TrajectoryStateClosestToPoint const & TSCP1 = TransTkPtr1->trajectoryStateClosestToPoint(cxPt);
+		TrajectoryStateClosestToPoint const & TSCP2 = TransTkPtr2->trajectoryStateClosestToPoint(cxPt);
+		if (!TSCP1.isValid() || !TSCP2.isValid()) {
+			ws.monitor.reject(QWD0Monitor::kCrossingTSCP);
+			return;
+		}
+		if (TSCP1.momentum().dot(TSCP2.momentum())  < 0) {
+			ws.monitor.reject(QWD0Monitor::kQuadrant);
+			return;
+		}
+
+		// calculate mPiPi
+		double totalE = sqrt(TSCP1.momentum().mag2() + piMassSquared) + sqrt(TSCP2.momentum().mag2() + piMassSquared);
+		double totalESq = totalE*totalE;
+		double totalPSq = (TSCP1.momentum() + TSCP2.momentum()).mag2();
+		double mPiPi = sqrt(totalESq - totalPSq);
+		ws.monitor.fill(QWD0Monitor::kMPiPiValue, mPiPi);
+		if (qwd0::tracePairs) edm::LogVerbatim("QWD0Fitter") << "pair " << trdx1 << " " << trdx2 << ": mPiPi = " << mPiPi;
+		if (applyMPiPiCut_ && mPiPi > mPiPiCut_) {
+			ws.monitor.reject(QWD0Monitor::kMPiPi);
+			return;
+		}
+
+		// mass windows of the hypotheses from the momenta at the crossing point,
+		// the tolerance covers the change of the momenta in the vertex fit
+		if (applyPrefitD0MassCut_) {
+			double p1Sq = TSCP1.momentum().mag2();
+			double p2Sq = TSCP2.momentum().mag2();
+			bool pass = false;
+			for (unsigned ihyp = 0; ihyp < theHypotheses.size() && !pass; ++ihyp) {
+				const Hypothesis & hyp = theHypotheses[ihyp];
+				double window = hyp.massWindow + prefitD0MassTolerance_;
+				for (unsigned iassign = 0; iassign < (hyp.mass1 == hyp.mass2 ? 1u : 2u) && !pass; ++iassign) {
+					double m1 = iassign ? hyp.mass2 : hyp.mass1;
+					double m2 = iassign ? hyp.mass1 : hyp.mass2;
+					double totalE = sqrt(p1Sq + m1*m1) + sqrt(p2Sq + m2*m2);
+					double prefitMass = sqrt(totalE*totalE - totalPSq);
+					if (qwd0::tracePairs) edm::LogVerbatim("QWD0Fitter") << "pair " << trdx1 << " " << trdx2 << ": prefit mass '" << hyp.label
+						<< "' " << iassign << " = " << prefitMass;
+					pass = std::abs(prefitMass - hyp.mass) <= window;
+				}
+			}
+			if (!pass) {
+				ws.monitor.reject(QWD0Monitor::kPrefitD0Mass);
+				return;
+			}
+		}
+
+		// the reference of the pair: the vertex nearest in z to its daughters
+		// or to where its flight line from the crossing point passes the beam
+		// line, or the leading vertex
+		double pairZ = 0.;
+		if (vertexAssociation_ == kDzVertex) {
+			double w1 = 1./(theTracks.sigmaZBeam[trdx1]*theTracks.sigmaZBeam[trdx1]);
+			double w2 = 1./(theTracks.sigmaZBeam[trdx2]*theTracks.sigmaZBeam[trdx2]);
+			pairZ = (w1*theTracks.zBeam[trdx1] + w2*theTracks.zBeam[trdx2])/(w1 + w2);
+		} else if (vertexAssociation_ == kPointingVertex && (TSCP1.momentum() + TSCP2.momentum()).perp2() > 0.) {
+			GlobalVector flight = TSCP1.momentum() + TSCP2.momentum();
+			double t = -((cxPt.x() - theBeamSpot->x0())*flight.x() + (cxPt.y() - theBeamSpot->y0())*flight.y())/flight.perp2();
+			pairZ = cxPt.z() + t*flight.z();
+		}
+		const int ivtx = associateVertex(pairZ);
+		const math::XYZPoint referencePos = referencePosition(ivtx);
+		const SMatrixSym3D & referenceCov = referenceCovariance(ivtx);
+
+		// skip the vertex fit for pairs whose analytic vertex estimate clearly
+		// fails the decay significance or the pointing cut
+		if (analyticPrefit_) {
+			pairTimer.start(QWD0Monitor::kAnalyticVertexStage);
+			double sigXY, angleXY, sigmaAngleXY;
+			if (analyticVertexXY(TSCP1, TSCP2, cxPt, referencePos, referenceCov, sigXY, angleXY, sigmaAngleXY)) {
+				if (qwd0::tracePairs) edm::LogVerbatim("QWD0Fitter") << "pair " << trdx1 << " " << trdx2 << ": analytic sigXY = " << sigXY
+					<< " angleXY = " << angleXY << " +- " << sigmaAngleXY;
+				bool failSigXY = applyVtxDecaySigXYCut_ && sigXY + analyticVertexMargin_ < vtxDecaySigXYCut_;
+				bool failAngleXY = cosThetaXYCut_ > -1. &&
+					acos(std::max(-1., std::min(1., angleXY))) - analyticVertexMargin_*sigmaAngleXY > acos(std::min(1., cosThetaXYCut_));
+				if (failSigXY || failAngleXY) {
+					ws.monitor.reject(QWD0Monitor::kAnalyticVertex);
+					return;
+				}
+			}
+		}
+
+		// the fits of the event are capped, in the serial loop only
+		if (maxVertexFits_ > 0 && workspace.nVertexFits++ >= maxVertexFits_) {
+			ws.monitor.reject(QWD0Monitor::kFitBudget);
+			return;
+		}
+
+		// Fill the vector of TransientTracks to send to KVF
+		pairTimer.start(QWD0Monitor::kVertexFitStage);
+		++ws.nFits;
+		ws.fitTracks[0] = *TransTkPtr1;
+		ws.fitTracks[1] = *TransTkPtr2;
+
+		// vertex the tracks with the stream's fitter
+		TransientVertex theRecoVertex = ws.fitter->vertex(ws.fitTracks);
+		if (!theRecoVertex.isValid()) {
+			if (qwd0::tracePairs) edm::LogVerbatim("QWD0Fitter") << "pair " << trdx1 << " " << trdx2 << ": vertex fit failed";
+			ws.monitor.reject(QWD0Monitor::kVertexFit);
+			return;
+		}
+
+		reco::Vertex theVtx = theRecoVertex;
+		ws.monitor.fill(QWD0Monitor::kVtxChi2Value, theVtx.normalizedChi2());
+		if (theVtx.normalizedChi2() > vtxChi2Cut_) {
+			if (qwd0::tracePairs) edm::LogVerbatim("QWD0Fitter") << "pair " << trdx1 << " " << trdx2 << ": normalizedChi2 = " << theVtx.normalizedChi2();
+			ws.monitor.reject(QWD0Monitor::kVtxChi2);
+			return;
+		}
+		if ( TMath::Prob(theVtx.chi2(), theVtx.ndof()) < vtxProb_ ) {
+			if (qwd0::tracePairs) edm::LogVerbatim("QWD0Fitter") << "pair " << trdx1 << " " << trdx2 << ": vtxProb = " << TMath::Prob(theVtx.chi2(), theVtx.ndof());
+			ws.monitor.reject(QWD0Monitor::kVtxProb);
+			return;
+		}
+		GlobalPoint vtxPos(theVtx.x(), theVtx.y(), theVtx.z());
+
+		// 2D decay significance
+		SMatrixSym3D totalCov = referenceCov + theVtx.covariance();
+		SVector3 distVecXY(vtxPos.x()-referencePos.x(), vtxPos.y()-referencePos.y(), 0.);
+		double distMagXY = ROOT::Math::Mag(distVecXY);
+		double sigmaDistMagXY = sqrt(ROOT::Math::Similarity(totalCov, distVecXY)) / distMagXY;
+		ws.monitor.fill(QWD0Monitor::kDecaySigXYValue, distMagXY/sigmaDistMagXY);
+		if (qwd0::tracePairs) edm::LogVerbatim("QWD0Fitter") << "pair " << trdx1 << " " << trdx2 << ": distMagXY/sigmaDistMagXY = " << distMagXY/sigmaDistMagXY;
+		if (applyVtxDecaySigXYCut_ && distMagXY/sigmaDistMagXY < vtxDecaySigXYCut_) {
+			ws.monitor.reject(QWD0Monitor::kDecaySigXY);
+			return;
+		}
+
+		// 3D decay significance
+		SVector3 distVecXYZ(vtxPos.x()-referencePos.x(), vtxPos.y()-referencePos.y(), vtxPos.z()-referencePos.z());
+		double distMagXYZ = ROOT::Math::Mag(distVecXYZ);
+		double sigmaDistMagXYZ = sqrt(ROOT::Math::Similarity(totalCov, distVecXYZ)) / distMagXYZ;
+		ws.monitor.fill(QWD0Monitor::kDecaySigXYZValue, distMagXYZ/sigmaDistMagXYZ);
+		if (qwd0::tracePairs) edm::LogVerbatim("QWD0Fitter") << "pair " << trdx1 << " " << trdx2 << ": distMagXYZ/sigmaDistMagXYZ = " << distMagXYZ/sigmaDistMagXYZ;
+		if (applyVtxDecaySigXYZCut_ && distMagXYZ/sigmaDistMagXYZ < vtxDecaySigXYZCut_) {
+			ws.monitor.reject(QWD0Monitor::kDecaySigXYZ);
+			return;
+		}
+
+		// make sure the vertex radius is within the inner track hit radius
+		// needs the TrackExtra, so not available on AOD
+		if (applyInnerHitPosCut_ && innerHitPosCut_ > 0. && TrackRef1->innerOk()) {
+			reco::Vertex::Point posTkHitPos = TrackRef1->innerPosition();
+			double posTkHitPosD2 =  (posTkHitPos.x()-referencePos.x())*(posTkHitPos.x()-referencePos.x()) +
+				(posTkHitPos.y()-referencePos.y())*(posTkHitPos.y()-referencePos.y());
+			if (sqrt(posTkHitPosD2) < (distMagXY - sigmaDistMagXY*innerHitPosCut_)) {
+				ws.monitor.reject(QWD0Monitor::kInnerHitPos);
+				return;
+			}
+		}
+		if (applyInnerHitPosCut_ && innerHitPosCut_ > 0. && TrackRef2->innerOk()) {
+			reco::Vertex::Point negTkHitPos = TrackRef2->innerPosition();
+			double negTkHitPosD2 = (negTkHitPos.x()-referencePos.x())*(negTkHitPos.x()-referencePos.x()) +
+				(negTkHitPos.y()-referencePos.y())*(negTkHitPos.y()-referencePos.y());
+			if (sqrt(negTkHitPosD2) < (distMagXY - sigmaDistMagXY*innerHitPosCut_)) {
+				ws.monitor.reject(QWD0Monitor::kInnerHitPos);
+				return;
+			}
+		}
+
+		// momenta at the vertex: the smoothed states of the refitted tracks sit
+		// at the vertex already, so only the original tracks are propagated.
+		// The fitter only refits the tracks if useRefTracks is set.
+		pairTimer.start(QWD0Monitor::kVertexTSCPStage);
+		GlobalVector P1, P2;
+		if (useRefTracks_ && theRecoVertex.hasRefittedTracks() && theRecoVertex.refittedTracks().size() > 1) {
+			const std::vector<reco::TransientTrack> & theRefTracks = theRecoVertex.refittedTracks();
+			P1 = theRefTracks[0].initialFreeState().momentum();
+			P2 = theRefTracks[1].initialFreeState().momentum();
+		} else {
+			TrajectoryStateClosestToPoint const & traj1 = TransTkPtr1->trajectoryStateClosestToPoint(vtxPos);
+			TrajectoryStateClosestToPoint const & traj2 = TransTkPtr2->trajectoryStateClosestToPoint(vtxPos);
+			if (!traj1.isValid() || !traj2.isValid()) {
+				ws.monitor.reject(QWD0Monitor::kVertexTSCP);
+				return;
+			}
+			P1 = traj1.momentum();
+			P2 = traj2.momentum();
+		}
+		GlobalVector totalP(P1 + P2);
+
+		// 2D pointing angle
+		double dx = theVtx.x()-referencePos.x();
+		double dy = theVtx.y()-referencePos.y();
+		double px = totalP.x();
+		double py = totalP.y();
+		double angleXY = (dx*px+dy*py)/(sqrt(dx*dx+dy*dy)*sqrt(px*px+py*py));
+		ws.monitor.fill(QWD0Monitor::kCosThetaXYValue, angleXY);
+		if (angleXY < cosThetaXYCut_) {
+			if (qwd0::tracePairs) edm::LogVerbatim("QWD0Fitter") << "pair " << trdx1 << " " << trdx2 << ": angleXY = " << angleXY;
+			ws.monitor.reject(QWD0Monitor::kCosThetaXY);
+			return;
+		}
+
+		// 3D pointing angle
+		double dz = theVtx.z()-referencePos.z();
+		double pz = totalP.z();
+		double angleXYZ = (dx*px+dy*py+dz*pz)/(sqrt(dx*dx+dy*dy+dz*dz)*sqrt(px*px+py*py+pz*pz));
+		ws.monitor.fill(QWD0Monitor::kCosThetaXYZValue, angleXYZ);
+		if (qwd0::tracePairs) edm::LogVerbatim("QWD0Fitter") << "pair " << trdx1 << " " << trdx2 << ": angleXYZ = " << angleXYZ;
+		if (applyCosThetaXYZCut_ && angleXYZ < cosThetaXYZCut_) {
+			ws.monitor.reject(QWD0Monitor::kCosThetaXYZ);
+			return;
+		}
+
+		// build the candidates of every hypothesis and mass assignment that
+		// passes, in place in the Event collections, and/or their compact rows
+		pairTimer.start(QWD0Monitor::kCandidateStage);
+		reco::Particle::Point vtx(theVtx.x(), theVtx.y(), theVtx.z());
+		const reco::Vertex::CovarianceMatrix vtxCov(theVtx.covariance());
+		double vtxChi2(theVtx.chi2());
+		double vtxNdof(theVtx.ndof());
+		const QWD0FittedPair fittedPair(TrackRef1.key(), TrackRef2.key(), vtx, vtxCov, vtxChi2, vtxNdof,
+				QWD0FittedPair::Vector(P1.x(), P1.y(), P1.z()), QWD0FittedPair::Vector(P2.x(), P2.y(), P2.z()));
+		if (storeFittedPairs_) out.fittedPairs.push_back(fittedPair);
+		double p1Sq = P1.mag2();
+		double p2Sq = P2.mag2();
+		bool accepted = false;
+		for (unsigned ihyp = 0; ihyp < theHypotheses.size(); ++ihyp) {
+			const Hypothesis & hyp = theHypotheses[ihyp];
+			int pdgId = charge1 == charge2 ? hyp.sameSignPdgId : hyp.pdgId;
+			if (pdgId == 0) continue;
+			if (hyp.applyVtxDecaySigXYCut && distMagXY/sigmaDistMagXY < hyp.vtxDecaySigXYCut) continue;
+			if (hyp.applyVtxDecaySigXYZCut && distMagXYZ/sigmaDistMagXYZ < hyp.vtxDecaySigXYZCut) continue;
+			if (angleXY < hyp.cosThetaXYCut) continue;
+			if (hyp.applyCosThetaXYZCut && angleXYZ < hyp.cosThetaXYZCut) continue;
+
+			unsigned nAssign = hyp.mass1 == hyp.mass2 ? 1u : 2u;
+			double masses[2];
+			unsigned assignments = 0;
+			reco::Particle::LorentzVector p4s[2];
+			for (unsigned iassign = 0; iassign < nAssign; ++iassign) {
+				double m1 = iassign ? hyp.mass2 : hyp.mass1;
+				double m2 = iassign ? hyp.mass1 : hyp.mass2;
+
+				// Create daughter candidates for the VertexCompositeCandidates
+				reco::RecoChargedCandidate theCand1(charge1, reco::Particle::LorentzVector(P1.x(), P1.y(), P1.z(), sqrt(p1Sq + m1*m1)), vtx);
+				reco::RecoChargedCandidate theCand2(charge2, reco::Particle::LorentzVector(P2.x(), P2.y(), P2.z(), sqrt(p2Sq + m2*m2)), vtx);
+
+				// four-momentum as AddFourMomenta would set it from the daughters
+				p4s[iassign] = theCand1.p4() + theCand2.p4();
+				double mass = masses[iassign] = p4s[iassign].mass();
+				if (ihyp == 0) ws.monitor.fill(iassign ? QWD0Monitor::kMassKPValue : QWD0Monitor::kMassPKValue, mass);
+				if (qwd0::tracePairs) edm::LogVerbatim("QWD0Fitter") << "pair " << trdx1 << " " << trdx2 << ": mass '" << hyp.label
+					<< "' " << iassign << " = " << mass;
+				if ( !(mass < hyp.mass + hyp.massWindow and mass > hyp.mass - hyp.massWindow) ) continue;
+				assignments |= iassign ? QWD0CompactCandidates::kSecondIsMass1 : QWD0CompactCandidates::kFirstIsMass1;
+			}
+			if (nAssign == 1) masses[1] = masses[0];
+			// only the assignment closer to the mass of the hypothesis is kept,
+			// the compact row records that it was chosen
+			bool chosen = massAssignment_ != kBothAssignments &&
+				assignments == (QWD0CompactCandidates::kFirstIsMass1 | QWD0CompactCandidates::kSecondIsMass1);
+			if (chosen) {
+				assignments = std::abs(masses[0] - hyp.mass) <= std::abs(masses[1] - hyp.mass) ?
+					QWD0CompactCandidates::kFirstIsMass1 : QWD0CompactCandidates::kSecondIsMass1;
+			}
+
+			for (unsigned iassign = 0; iassign < nAssign; ++iassign) {
+				if (!(assignments & (iassign ? QWD0CompactCandidates::kSecondIsMass1 : QWD0CompactCandidates::kFirstIsMass1))) continue;
+				ws.monitor.countCandidate(ihyp);
+				accepted = true;
+				if (!storeCandidates_) continue;
+				double m1 = iassign ? hyp.mass2 : hyp.mass1;
+				double m2 = iassign ? hyp.mass1 : hyp.mass2;
+				reco::RecoChargedCandidate theCand1(charge1, reco::Particle::LorentzVector(P1.x(), P1.y(), P1.z(), sqrt(p1Sq + m1*m1)), vtx);
+				reco::RecoChargedCandidate theCand2(charge2, reco::Particle::LorentzVector(P2.x(), P2.y(), P2.z(), sqrt(p2Sq + m2*m2)), vtx);
+
+				// the sign follows the mass1 daughter
+				theCand1.setTrack(TrackRef1);
+				theCand2.setTrack(TrackRef2);
+				int mass1Charge = iassign ? charge2 : charge1;
+				out.candidates[ihyp].emplace_back(charge1 + charge2, p4s[iassign], vtx, vtxCov, vtxChi2, vtxNdof);
+				reco::VertexCompositeCandidate & theCand = out.candidates[ihyp].back();
+				theCand.addDaughter(theCand1);
+				theCand.addDaughter(theCand2);
+				theCand.setPdgId(hyp.chargeConjugate && mass1Charge < 0 ? -pdgId : pdgId);
+				std::vector<std::vector<float>> & variables = out.variables[ihyp];
+				if (storeVariables_) {
+					variables[kDCAVariable].push_back(dca);
+					variables[kMPiPiVariable].push_back(mPiPi);
+					variables[kDecaySigXYVariable].push_back(distMagXY/sigmaDistMagXY);
+					variables[kDecaySigXYZVariable].push_back(distMagXYZ/sigmaDistMagXYZ);
+					variables[kCosThetaXYVariable].push_back(angleXY);
+					variables[kCosThetaXYZVariable].push_back(angleXYZ);
+				}
+				if (storeVariable(kSwappedMassVariable)) variables[kSwappedMassVariable].push_back(masses[1 - iassign]);
+			}
+			if (storeCompactCandidates_ && assignments) {
+				out.compactCandidates[ihyp].push_back(fittedPair, charge1, charge2,
+						assignments | (chosen ? QWD0CompactCandidates::kChosenAssignment : 0u),
+						masses[0], nAssign > 1 ? masses[1] : masses[0], dca, mPiPi,
+						distMagXY/sigmaDistMagXY, distMagXYZ/sigmaDistMagXYZ, angleXY, angleXYZ);
+			}
+		}
+		if (!accepted) ws.monitor.reject(QWD0Monitor::kD0Mass);
+		// at most twice the cap is held while fitting
+		if (maxCandidates_ > 0 && maxCandidatesPerTrack_ == 0) {
+			bool full = out.fittedPairs.size() >= 2*maxCandidates_*theHypotheses.size();
+			for (unsigned ihyp = 0; ihyp < theHypotheses.size(); ++ihyp) {
+				full = full || out.candidates[ihyp].size() >= 2*maxCandidates_ || out.compactCandidates[ihyp].size() >= 2*maxCandidates_;
+			}
+			if (full) capOutput(out);
+		}
+	};
+
+	// drop the partners of trdx1 that can not pass the cheap cuts in one
+	// batch, then vertex the survivors
+	auto fitPartners = [&](LoopWorkspace & ws, unsigned int trdx1, const std::vector<unsigned> & partners, Output & out) {
+		if (!pairPrefilter_) {
+			for (unsigned int trdx2 : partners) fitPair(ws, trdx1, trdx2, out);
+			return;
+		}
+		QWD0Monitor::StageTimer filterTimer(ws.monitor);
+		filterTimer.start(QWD0Monitor::kPrefilterStage);
+		unsigned nSurvivors = thePairFilter.filter(theTracks, trdx1, partners, ws.survivors);
+		filterTimer.stop();
+		ws.monitor.countPairs(partners.size() - nSurvivors);
+		ws.monitor.reject(QWD0Monitor::kPrefilter, partners.size() - nSurvivors);
+		for (unsigned int trdx2 : ws.survivors) fitPair(ws, trdx1, trdx2, out);
+	};
+
+	// the partners of one track, in increasing order. The brute-force loop
+	// takes the requested charge combinations from the positive and negative
+	// track lists; with both it pairs every track, for validation.
+	const QWD0PairFinder::ChargeCombination charges = workspace.pairFinder.chargeCombination();
+	auto findPartners = [&](unsigned int trdx1, std::vector<unsigned> & partners) {
+		partners.clear();
+		if (!bruteForcePairs_) {
+			workspace.pairFinder.partners(trdx1, partners);
+			if (workspace.zWindow.enabled()) workspace.zWindow.filter(trdx1, partners);
+		} else if (workspace.zWindow.enabled()) {
+			workspace.zWindow.partners(trdx1, partners);
+			if (charges == QWD0PairFinder::kBothSigns) return;
+			int charge1 = theTracks.charge[trdx1];
+			bool sameSign = charges == QWD0PairFinder::kSameSign;
+			partners.erase(std::remove_if(partners.begin(), partners.end(), [&](unsigned trdx2) {
+				return charge1 == 0 || theTracks.charge[trdx2] == 0 || (theTracks.charge[trdx2] == charge1) != sameSign;
+			}), partners.end());
+		} else if (charges == QWD0PairFinder::kBothSigns) {
+			for (unsigned int trdx2 = trdx1 + 1; trdx2 < theTracks.size(); ++trdx2) partners.push_back(trdx2);
+		} else if (theTracks.charge[trdx1] != 0) {
+			bool positive = theTracks.charge[trdx1] > 0;
+			const std::vector<unsigned> & tracks = (positive == (charges == QWD0PairFinder::kSameSign)) ?
+				theTracks.positive : theTracks.negative;
+			partners.assign(std::upper_bound(tracks.begin(), tracks.end(), trdx1), tracks.end());
+		}
+	};
+
+	// the fits run, and the pairs that claimed a fit beyond the budget
+	workspace.nVertexFits = 0;
+	theLoop.nPairs = 0;
+	theLoop.nFits = 0;
+	auto countFits = [&]() {
+		unsigned nClaimed = workspace.nVertexFits;
+		output.throttle.setFits(theLoop.nFits, maxVertexFits_ > 0 && nClaimed > maxVertexFits_ ? nClaimed - maxVertexFits_ : 0);
+	};
+
+	stageTimer.start(QWD0Monitor::kPairingStage);
+	if (!bruteForcePairs_) workspace.pairFinder.build(theTracks);
+	if (workspace.zWindow.enabled()) workspace.zWindow.build(theTracks);
+	stageTimer.stop();
+
+	// reserve the candidates from the pairs that will be handed to the fit,
+	// the pairs of preselected tracks times their share handed to the fit in
+	// the earlier events
+	const double nCombinations = 0.5*theTracks.size()*(theTracks.size() - 1.);
+	const double expectedPairs = workspace.pairsPerCombination*nCombinations;
+	workspace.candidatesPerPair.resize(theHypotheses.size(), -1.);
+	workspace.lastCandidates.resize(theHypotheses.size(), 0);
+	for (unsigned ihyp = 0; storeCandidates_ && ihyp < theHypotheses.size(); ++ihyp) {
+		if (workspace.candidatesPerPair[ihyp] < 0. || expectedPairs < 0.) continue;
+		size_t n = reserveMargin*expectedPairs*workspace.candidatesPerPair[ihyp] + 1;
+		n = std::min(n, reserveGrowth*workspace.lastCandidates[ihyp] + reserveFloor);
+		if (maxCandidates_ > 0) n = std::min<size_t>(n, 2*maxCandidates_);
+		output.candidates[ihyp].reserve(n);
+		for (unsigned ivar = 0; ivar < output.variables[ihyp].size(); ++ivar) {
+			if (storeVariable(Variable(ivar))) output.variables[ihyp][ivar].reserve(n);
+		}
+	}
+
+	// update the estimates from the pairs handed to the fit, and cap the outputs
+	auto finish = [&]() {
+		countFits();
+		for (unsigned stage = 0; storeStageTimes_ && stage < QWD0Monitor::nStages; ++stage) {
+			QWD0Monitor::Stage s = QWD0Monitor::Stage(stage);
+			output.stageTimes.set(s, theLoop.monitor.nanoseconds(s) - startNanoseconds[stage], theLoop.monitor.calls(s) - startCalls[stage]);
+		}
+		if (storeStageTimes_) {
+			output.stageTimes.setEvent(theTracks.size(), theLoop.nFits,
+					std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - eventStart).count());
+		}
+		const double nPairs = theLoop.nPairs;
+		if (nCombinations > 0.) {
+			double share = nPairs/nCombinations;
+			double & estimate = workspace.pairsPerCombination;
+			estimate = estimate < 0. ? share : 0.9*estimate + 0.1*share;
+		}
+		for (unsigned ihyp = 0; storeCandidates_ && ihyp < theHypotheses.size(); ++ihyp) {
+			double perPair = nPairs > 0. ? output.candidates[ihyp].size()/nPairs : 0.;
+			double & estimate = workspace.candidatesPerPair[ihyp];
+			if (nPairs > 0.) estimate = estimate < 0. ? perPair : 0.9*estimate + 0.1*perPair;
+			workspace.lastCandidates[ihyp] = output.candidates[ihyp].size();
+		}
+		if (maxCandidates_ > 0 || maxCandidatesPerTrack_ > 0) capOutput(output);
+	};
+
+	// vertex the pairs of the first tracks [begin, end)
+	auto fitTracks = [&](LoopWorkspace & ws, unsigned int begin, unsigned int end, Output & out) {
+		for (unsigned int trdx1 = begin; trdx1 < end; ++trdx1) {
+			findPartners(trdx1, ws.partners);
+			if (!ws.partners.empty()) fitPartners(ws, trdx1, ws.partners, out);
+		}
+	};
+
+	// loop over tracks and vertex good charged track pairs
+	if (parallelMinTracks_ == 0 || theTracks.size() < parallelMinTracks_) {
+		fitTracks(theLoop, 0, theTracks.size(), output);
+		finish();
+		return;
+	}
+
+	// split the first tracks into chunks fitted in TBB tasks, in the task
+	// arena of the module. Each chunk keeps its candidates in the serial
+	// order, so concatenating the chunks gives the same output for any
+	// number of threads.
+	unsigned nChunks = (theTracks.size() + parallelChunkSize_ - 1) / parallelChunkSize_;
+	workspace.chunkOutputs.resize(nChunks);
+	for (Output & out : workspace.chunkOutputs) {
+		out.candidates.resize(theHypotheses.size());
+		out.compactCandidates.resize(theHypotheses.size());
+		out.variables.resize(theHypotheses.size(), std::vector<std::vector<float>>(storeAnyVariable() ? nVariables : 0));
+	}
+	tbb::parallel_for(0u, nChunks, [&](unsigned ichunk) {
+		LoopWorkspace & ws = workspace.taskLoops.local();
+		Output & out = workspace.chunkOutputs[ichunk];
+		fitTracks(ws, ichunk*parallelChunkSize_, std::min<unsigned>(theTracks.size(), (ichunk + 1)*parallelChunkSize_), out);
+	});
+
+	for (unsigned ihyp = 0; ihyp < theHypotheses.size(); ++ihyp) {
+		concatenate(output.candidates[ihyp], workspace.chunkOutputs, [ihyp](Output & out) -> reco::VertexCompositeCandidateCollection & { return out.candidates[ihyp]; });
+		for (Output & out : workspace.chunkOutputs) output.compactCandidates[ihyp].append(out.compactCandidates[ihyp]);
+		for (unsigned ivar = 0; ivar < output.variables[ihyp].size(); ++ivar) {
+			concatenate(output.variables[ihyp][ivar], workspace.chunkOutputs, [ihyp, ivar](Output & out) -> std::vector<float> & { return out.variables[ihyp][ivar]; });
+		}
+	}
+	concatenate(output.fittedPairs, workspace.chunkOutputs, [](Output & out) -> QWD0FittedPairCollection & { return out.fittedPairs; });
+	for (LoopWorkspace & ws : workspace.taskLoops) {
+		theLoop.monitor.merge(ws.monitor);
+		ws.monitor.clear();
+		theLoop.nPairs += ws.nPairs;
+		ws.nPairs = 0;
+		theLoop.nFits += ws.nFits;
+		ws.nFits = 0;
+	}
+	finish();
+}
@@ -0,0 +1,317 @@
+#ifndef QWD0_FITTER_H
+#define QWD0_FITTER_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tbb/enumerable_thread_specific.h"
+
+#include "FWCore/Framework/interface/Event.h"
+#include "FWCore/Framework/interface/ESHandle.h"
+#include "FWCore/Framework/interface/ESWatcher.h"
+#include "FWCore/Utilities/interface/InputTag.h"
+#include "DataFormats/Common/interface/Ref.h"
+#include "DataFormats/TrackReco/interface/Track.h"
+#include "RecoVertex/VertexPrimitives/interface/TransientVertex.h"
+#include "RecoVertex/VertexPrimitives/interface/VertexFitter.h"
+#include "TrackingTools/TransientTrack/interface/TransientTrack.h"
+#include "RecoVertex/KalmanVertexFit/interface/KalmanVertexFitter.h"
+#include "RecoVertex/AdaptiveVertexFit/interface/AdaptiveVertexFitter.h"
+#include "MagneticField/Records/interface/IdealMagneticFieldRecord.h"
+#include "MagneticField/VolumeBasedEngine/interface/VolumeBasedMagneticField.h"
+#include "DataFormats/Candidate/interface/VertexCompositeCandidate.h"
+#include "DataFormats/RecoCandidate/interface/RecoChargedCandidate.h"
+#include "FWCore/ParameterSet/interface/ParameterSet.h"
+#include "Geometry/CommonDetUnit/interface/TrackingGeometry.h"
+#include "Geometry/CommonDetUnit/interface/GeomDetUnit.h"
+#include "Geometry/TrackerGeometryBuilder/interface/TrackerGeometry.h"
+#include "Geometry/Records/interface/TrackerDigiGeometryRecord.h"
+#include "Geometry/CommonDetUnit/interface/GeomDet.h"
+#include "Geometry/TrackerGeometryBuilder/interface/GluedGeomDet.h"
+#include "FWCore/Framework/interface/ConsumesCollector.h"
+#include "DataFormats/TrackingRecHit/interface/TrackingRecHit.h"
+#include "DataFormats/BeamSpot/interface/BeamSpot.h"
+#include "DataFormats/Math/interface/Error.h"
+#include "DataFormats/Provenance/interface/LuminosityBlockID.h"
+#include "QWAna/QWD0Producer/interface/QWD0FittedPair.h"
+#include "QWAna/QWD0Producer/interface/QWD0CompactCandidates.h"
+#include "QWAna/QWD0Producer/interface/QWD0ThrottleInfo.h"
+#include "QWAna/QWD0Producer/interface/QWD0StageTimes.h"
+
+#include "QWD0TrackCache.h"
+#include "QWD0PairFinder.h"
+#include "QWD0PairFilter.h"
+#include "QWD0ZWindow.h"
+#include "QWD0Monitor.h"
+#include "QWD0VertexIndex.h"
+
+// The configuration of the D0 reconstruction, immutable once constructed so
+// one instance can be shared by all streams of a global module. The state
+// of the fits lives in a Workspace, one per stream.
+class dso_hidden QWD0Fitter {
+public:
+	QWD0Fitter(const edm::ParameterSet& theParams, edm::ConsumesCollector && iC);
+
+	// selection variables stored for each candidate, if storeVariable()
+	enum Variable {
+		kDCAVariable,
+		kMPiPiVariable,
+		kDecaySigXYVariable,
+		kDecaySigXYZVariable,
+		kCosThetaXYVariable,
+		kCosThetaXYZVariable,
+		// the mass with the daughter masses swapped
+		kSwappedMassVariable,
+		nVariables
+	};
+	static const char * variableName(Variable var);
+
+	// the products of one event
+	struct Output {
+		// one collection per hypothesis, in the order of hypothesisLabels()
+		std::vector<reco::VertexCompositeCandidateCollection> candidates;
+		// every pair passing the shared vertex cuts, if storeFittedPairs()
+		QWD0FittedPairCollection fittedPairs;
+		// the rows of each hypothesis, if storeCompactCandidates()
+		std::vector<QWD0CompactCandidates> compactCandidates;
+		// indexed by hypothesis and Variable, one value per candidate
+		std::vector<std::vector<std::vector<float>>> variables;
+		// the multiplicity step and fit budget of the event, if throttled()
+		QWD0ThrottleInfo throttle;
+		// the time in each stage, if storeStageTimes()
+		QWD0StageTimes stageTimes;
+	};
+
+	class Workspace;
+	std::unique_ptr<Workspace> makeWorkspace() const;
+	// only one call per workspace at a time
+	void fitAll(const edm::Event& iEvent, const edm::EventSetup& iSetup, Workspace & workspace, Output & output) const;
+
+	// product instance labels, "" for the D0
+	std::vector<std::string> hypothesisLabels() const;
+	bool storeFittedPairs() const { return storeFittedPairs_; }
+	// outputFormat 'candidates', 'compact' or 'both'
+	bool storeCandidates() const { return storeCandidates_; }
+	bool storeCompactCandidates() const { return storeCompactCandidates_; }
+	// all with storeVariables, swappedMass alone with the 'single' massAssignment
+	bool storeVariable(Variable var) const {
+		return storeVariables_ || (var == kSwappedMassVariable && massAssignment_ == kSingleAssignment);
+	}
+	bool storeAnyVariable() const { return storeVariables_ || massAssignment_ == kSingleAssignment; }
+	// multiplicitySteps or maxVertexFits are set
+	bool throttled() const { return !theMultiplicitySteps.empty() || maxVertexFits_ > 0; }
+	bool storeStageTimes() const { return storeStageTimes_; }
+
+private:
+	// the vertex fitter, scratch storage and monitor of one pair loop, set up
+	// once so rejected pairs do not allocate. The serial pair loop runs in
+	// the loop of the Workspace, the parallel one in one per thread.
+	struct LoopWorkspace {
+		LoopWorkspace(VertexFitter<5> * theFitter, bool fillHistograms, bool timing);
+		std::unique_ptr<VertexFitter<5>> fitter;
+		std::vector<reco::TransientTrack> fitTracks;
+		std::vector<unsigned> partners;
+		std::vector<unsigned> survivors;
+		// pairs handed to the fit and vertex fits run in this loop in the
+		// current event
+		unsigned nPairs;
+		unsigned nFits;
+		QWD0Monitor monitor;
+	};
+
+	// applies maxCandidates and maxCandidatesPerTrack to the products of output
+	void capOutput(Output & output) const;
+
+	// the preselected tracks before the multiplicity steps
+	struct PreselectedTrack {
+		unsigned key;
+		float ipSigXY;
+		float ipSigZ;
+		float zBeam;
+	};
+
+	// A two-body decay tested on every fitted pair. The first one is the D0
+	// from the top-level cuts, the others come from extraHypotheses. The
+	// daughters keep the track order, each pair is tried with the first
+	// track as mass1 and, if the masses differ, with the second one.
+	struct Hypothesis {
+		std::string label;
+		double mass1;
+		double mass2;
+		double mass;
+		double massWindow;
+		// signed by the charge of the mass1 daughter if chargeConjugate,
+		// same sign pairs get sameSignPdgId or are skipped if it is 0
+		int pdgId;
+		int sameSignPdgId;
+		bool chargeConjugate;
+		double vtxDecaySigXYCut;
+		double vtxDecaySigXYZCut;
+		double cosThetaXYCut;
+		double cosThetaXYZCut;
+		bool applyVtxDecaySigXYCut;
+		bool applyVtxDecaySigXYZCut;
+		bool applyCosThetaXYZCut;
+	};
+
+	// KalmanVertexFitter, else AdaptiveVertexFitter
+	bool vertexFitter_;
+	// analytic vertex estimate ahead of the fit
+	bool analyticPrefit_;
+	// sigmas the estimate may be off by
+	double analyticVertexMargin_;
+	bool useRefTracks_;
+	// cloned into each LoopWorkspace
+	std::unique_ptr<VertexFitter<5>> theVertexFitter;
+	bool monitorHistograms_;
+	bool monitorTiming_;
+	// time the stages of each event for the QWD0StageTimes product
+	bool storeStageTimes_;
+	// loop over all pairs instead of the binned pairs, the default
+	bool bruteForcePairs_;
+	// run the batched pre-fit filter on the partners of each track
+	bool pairPrefilter_;
+	// configured copies for the workspaces
+	QWD0PairFinder thePairFinder;
+	QWD0PairFilter thePairFilter;
+	// pairs only inside a window in z at the beam line, for either pair finder
+	QWD0ZWindow theZWindow;
+
+	// fit the pairs of events with at least parallelMinTracks_ preselected
+	// tracks in TBB tasks of parallelChunkSize_ first tracks each, 0 disables
+	unsigned parallelMinTracks_;
+	unsigned parallelChunkSize_;
+
+	std::vector<Hypothesis> theHypotheses;
+	bool storeFittedPairs_;
+	bool storeCandidates_;
+	bool storeCompactCandidates_;
+	bool storeVariables_;
+
+	struct MultiplicityStep {
+		unsigned minTracks;
+		double tkPtCut;
+		double tkIPSigXYCut;
+	};
+	// in increasing minTracks
+	std::vector<MultiplicityStep> theMultiplicitySteps;
+	// vertex fits per event, 0 for no limit
+	unsigned maxVertexFits_;
+	// candidates of each hypothesis per event, the best by the single precision
+	// vtxProb of their pair are kept, in the candidates and the compact rows
+	// alike; the fitted pairs are the ones of the candidates kept, 0 for no limit
+	unsigned maxCandidates_;
+	// candidates of each hypothesis a track may be in, the best by vtxProb
+	// first, in the candidates and the compact rows alike, 0 for no limit
+	unsigned maxCandidatesPerTrack_;
+	// which of the two mass assignments of a pair passing the mass window
+	// become candidates: both, or the one closer to the mass of the
+	// hypothesis, also storing the swappedMass variable for single
+	enum MassAssignment {
+		kBothAssignments,
+		kClosestAssignment,
+		kSingleAssignment
+	};
+	MassAssignment massAssignment_;
+
+	// cuts on initial track selection
+	double tkChi2Cut_;
+	int tkNHitsCut_;
+	double tkPtCut_;
+	double tkIPSigXYCut_;
+	double tkIPSigZCut_;
+	// cuts on the vertex; the decay significance and pointing cuts (and
+	// their switches) are the loosest over the hypotheses, each hypothesis
+	// then applies its own on the candidates
+	double vtxChi2Cut_;
+	double vtxDecaySigXYCut_;
+	double vtxDecaySigXYZCut_;
+	double vtxProb_;
+	// miscellaneous cuts
+	double tkDCACut_;
+	double mPiPiCut_;
+	double innerHitPosCut_;
+	double cosThetaXYCut_;
+	double cosThetaXYZCut_;
+	// added to the mass windows of the hypotheses before the fit
+	double prefitD0MassTolerance_;
+
+	// switches for the optional cuts
+	bool applyTkDCACut_;
+	bool applyMPiPiCut_;
+	bool applyPrefitD0MassCut_;
+	bool applyVtxDecaySigXYCut_;
+	bool applyVtxDecaySigXYZCut_;
+	bool applyInnerHitPosCut_;
+	bool applyCosThetaXYZCut_;
+
+	edm::EDGetTokenT<reco::TrackCollection> token_tracks;
+	edm::EDGetTokenT<reco::BeamSpot> token_beamSpot;
+	bool useVertex_;
+	edm::EDGetTokenT<std::vector<reco::Vertex>> token_vertices;
+
+	// which primary vertex a track or pair is measured from with useVertex:
+	// the first one, or the one nearest in z to the track, to the daughters
+	// of the pair or to the flight line of the pair
+	enum VertexAssociation {
+		kLeadingVertex,
+		kDzVertex,
+		kPointingVertex
+	};
+	VertexAssociation vertexAssociation_;
+	// the beamspot is used if no vertex is this close in z [cm], < 0 never
+	double vertexAssociationMaxDz_;
+};
+
+// what fitAll changes while fitting an event, kept between events so the
+// caches do not allocate again
+class dso_hidden QWD0Fitter::Workspace {
+public:
+	explicit Workspace(const QWD0Fitter & fitter);
+
+	// the cuts of the pairs fitted in this workspace
+	const QWD0Monitor & monitor() const { return loop.monitor; }
+	QWD0Monitor & monitor() { return loop.monitor; }
+
+private:
+	friend class QWD0Fitter;
+
+	QWD0TrackCache tracks;
+	QWD0PairFinder pairFinder;
+	QWD0ZWindow zWindow;
+	QWD0VertexIndex vertexIndex;
+	// pt, normalized chi2 and valid hits of every track, the mask of the
+	// cuts on them and the tracks passing it
+	std::vector<double> trackPt;
+	std::vector<double> trackChi2;
+	std::vector<int> trackNHits;
+	std::vector<unsigned char> trackMask;
+	std::vector<unsigned> trackIndices;
+	std::vector<PreselectedTrack> preselected;
+	// the field of the current IOV
+	edm::ESWatcher<IdealMagneticFieldRecord> fieldWatcher;
+	const MagneticField * magneticField;
+	// the rotated beamspot covariance, kept while the luminosity block and
+	// the beamspot stay the same, followed by those of the vertices
+	edm::LuminosityBlockID beamSpotLumi;
+	double beamSpotX0;
+	double beamSpotY0;
+	double beamSpotZ0;
+	std::vector<math::Error<3>::type> referenceCovariances;
+	// pairs of the event that claimed a fit from maxVertexFits
+	unsigned nVertexFits;
+	// running estimates of the share of the track pairs handed to the fit
+	// and of the candidates of each hypothesis per such pair, -1 before the
+	// first event, and the candidates of the last event before the caps
+	double pairsPerCombination;
+	std::vector<double> candidatesPerPair;
+	std::vector<size_t> lastCandidates;
+	LoopWorkspace loop;
+	tbb::enumerable_thread_specific<LoopWorkspace> taskLoops;
+	// output of each chunk, concatenated in chunk order
+	std::vector<Output> chunkOutputs;
+};
+
+#endif
+
@@ -0,0 +1,208 @@
+#include "QWD0Monitor.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+
+#include "FWCore/MessageLogger/interface/MessageLogger.h"
+
+#ifdef QWD0_ITT
+#include <ittnotify.h>
+#endif
+#ifdef QWD0_SDT
+#include <sys/sdt.h>
+#endif
+
+namespace {
+	struct Binning {
+		unsigned nBins;
+		double lo;
+		double hi;
+	};
+
+	// indexed by QWD0Monitor::Variable
+	const Binning binnings[QWD0Monitor::nVariables] = {
+		{50, 0., 5.},
+		{60, 0., 3.},
+		{60, 0., 30.},
+		{50, 0., 100.},
+		{50, 0., 100.},
+		{50, 0.999, 1.},
+		{50, 0.999, 1.},
+		{50, 1.6, 2.1},
+		{50, 1.6, 2.1},
+	};
+
+#ifdef QWD0_ITT
+	// one ITT task name per stage, created on first use
+	struct IttStages {
+		IttStages() : domain(__itt_domain_create("QWD0Fitter")) {
+			for (unsigned stage = 0; stage < QWD0Cutflow::nStages; ++stage) {
+				names[stage] = __itt_string_handle_create(QWD0Cutflow::stageName(QWD0Cutflow::Stage(stage)));
+			}
+		}
+		__itt_domain * domain;
+		__itt_string_handle * names[QWD0Cutflow::nStages];
+	};
+	const IttStages & ittStages() {
+		static const IttStages stages;
+		return stages;
+	}
+#endif
+}
+
+#if defined(QWD0_ITT) || defined(QWD0_SDT)
+void qwd0::beginStageMarker(QWD0Cutflow::Stage stage)
+{
+#ifdef QWD0_ITT
+	const IttStages & itt = ittStages();
+	__itt_task_begin(itt.domain, __itt_null, __itt_null, itt.names[stage]);
+#endif
+#ifdef QWD0_SDT
+	DTRACE_PROBE1(qwd0, stage_begin, int(stage));
+#endif
+}
+
+void qwd0::endStageMarker(QWD0Cutflow::Stage stage)
+{
+#ifdef QWD0_ITT
+	__itt_task_end(ittStages().domain);
+#endif
+#ifdef QWD0_SDT
+	DTRACE_PROBE1(qwd0, stage_end, int(stage));
+#endif
+}
+#endif
+
+QWD0Monitor::QWD0Monitor(bool fillHistograms, bool timing) :
+	fillHistograms_(fillHistograms),
+	timing_(timing)
+{
+	if (fillHistograms_) {
+		for (unsigned var = 0; var < nVariables; ++var) {
+			histograms_[var] = Histogram(binnings[var].nBins, binnings[var].lo, binnings[var].hi);
+		}
+	}
+}
+
+void QWD0Monitor::clear()
+{
+	QWD0Cutflow::clear();
+	for (auto & h : histograms_) h.clear();
+	hypothesisCandidates_.assign(hypothesisCandidates_.size(), 0);
+}
+
+void QWD0Monitor::merge(const QWD0Monitor & other)
+{
+	mergeProduct(other);
+	if (other.hypothesisCandidates_.size() > hypothesisCandidates_.size()) hypothesisCandidates_.resize(other.hypothesisCandidates_.size(), 0);
+	for (unsigned ihyp = 0; ihyp < other.hypothesisCandidates_.size(); ++ihyp) hypothesisCandidates_[ihyp] += other.hypothesisCandidates_[ihyp];
+	if (fillHistograms_ && other.fillHistograms_) {
+		for (unsigned var = 0; var < nVariables; ++var) histograms_[var].merge(other.histograms_[var]);
+	}
+}
+
+void QWD0Monitor::report(const std::string & category, const std::string & moduleLabel, const std::vector<std::string> & hypothesisLabels) const
+{
+	edm::LogVerbatim out(category);
+	out << "QWD0Fitter summary";
+	if (!moduleLabel.empty()) out << " of " << moduleLabel;
+	out << ": " << nEvents_ << " events, " << nTracks_ << " tracks, "
+		<< nSelected_ << " preselected, " << nPairs_ << " pairs formed\n";
+
+	char line[128];
+	std::snprintf(line, sizeof(line), "  %-18s %14s %14s\n", "cut", "rejected", "remaining");
+	out << line;
+	for (unsigned cut = 0; cut < nCuts; ++cut) {
+		std::snprintf(line, sizeof(line), "  %-18s %14llu %14llu\n", cutName(Cut(cut)), rejected(Cut(cut)), remaining(Cut(cut)));
+		out << line;
+	}
+	out << "  candidates: " << nCandidates_;
+	for (unsigned ihyp = 0; ihyp < hypothesisCandidates_.size(); ++ihyp) {
+		out << (ihyp ? ", " : " (");
+		if (ihyp < hypothesisLabels.size()) out << hypothesisLabels[ihyp];
+		else out << "hypothesis " << ihyp;
+		out << " " << hypothesisCandidates_[ihyp];
+	}
+	if (!hypothesisCandidates_.empty()) out << ")";
+
+	if (timing_) {
+		std::snprintf(line, sizeof(line), "\n  %-18s %14s %14s %14s", "stage", "calls", "total [s]", "per call [us]");
+		out << line;
+		for (unsigned stage = 0; stage < nStages; ++stage) {
+			unsigned long long n = calls(Stage(stage));
+			std::snprintf(line, sizeof(line), "\n  %-18s %14llu %14.3f %14.3f", stageName(Stage(stage)), n,
+					time(Stage(stage)), n ? 1e6*time(Stage(stage))/n : 0.);
+			out << line;
+		}
+		// throughput over the timed stages
+		double total = 0.;
+		for (unsigned stage = 0; stage < nStages; ++stage) total += time(Stage(stage));
+		std::snprintf(line, sizeof(line), "\n  %.3f s in the stages, %.3f ms per event, %.0f pairs/s",
+				total, nEvents_ ? 1e3*total/nEvents_ : 0., total > 0. ? nPairs_/total : 0.);
+		out << line;
+	}
+
+	if (!fillHistograms_) return;
+	for (unsigned var = 0; var < nVariables; ++var) {
+		if (histograms_[var].empty()) continue;
+		out << "\n  " << variableName(Variable(var)) << ": " << histograms_[var].print();
+	}
+}
+
+const char * QWD0Monitor::variableName(Variable var)
+{
+	switch (var) {
+		case kDCAValue: return "dca";
+		case kMPiPiValue: return "mPiPi";
+		case kVtxChi2Value: return "vtxChi2";
+		case kDecaySigXYValue: return "vtxDecaySigXY";
+		case kDecaySigXYZValue: return "vtxDecaySigXYZ";
+		case kCosThetaXYValue: return "cosThetaXY";
+		case kCosThetaXYZValue: return "cosThetaXYZ";
+		case kMassPKValue: return "massPK";
+		case kMassKPValue: return "massKP";
+		default: return "unknown";
+	}
+}
+
+void QWD0Monitor::Histogram::fill(double x)
+{
+	unsigned nBins = counts_.size() - 2;
+	// NaN goes to the underflow, rounding up at hi_ to the overflow
+	if (!(x >= lo_)) {
+		++counts_[0];
+	} else if (!(x < hi_)) {
+		++counts_[nBins + 1];
+	} else {
+		++counts_[1 + std::min(nBins - 1, unsigned((x - lo_) / (hi_ - lo_) * nBins))];
+	}
+}
+
+void QWD0Monitor::Histogram::clear()
+{
+	counts_.assign(counts_.size(), 0);
+}
+
+void QWD0Monitor::Histogram::merge(const Histogram & other)
+{
+	for (unsigned bin = 0; bin < counts_.size() && bin < other.counts_.size(); ++bin) counts_[bin] += other.counts_[bin];
+}
+
+bool QWD0Monitor::Histogram::empty() const
+{
+	for (auto c : counts_) {
+		if (c) return false;
+	}
+	return true;
+}
+
+std::string QWD0Monitor::Histogram::print() const
+{
+	std::ostringstream os;
+	unsigned nBins = counts_.size() - 2;
+	os << "[" << lo_ << ", " << hi_ << ") in " << nBins << " bins, underflow " << counts_[0]
+		<< ", overflow " << counts_[nBins + 1] << ", contents";
+	for (unsigned bin = 1; bin <= nBins; ++bin) os << " " << counts_[bin];
+	return os.str();
+}
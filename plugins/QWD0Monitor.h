@@ -0,0 +1,165 @@
+#ifndef QWD0_MONITOR_H
+#define QWD0_MONITOR_H
+
+#include <array>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "QWAna/QWD0Producer/interface/QWD0Cutflow.h"
+
+namespace qwd0 {
+	// per-pair tracing in QWD0Fitter::fitAll, only compiled in for debug builds
+	// (scram b USER_CXXFLAGS="-DQWD0_TRACE", or EDM_ML_DEBUG)
+#if defined(QWD0_TRACE) || defined(EDM_ML_DEBUG)
+	constexpr bool tracePairs = true;
+#else
+	constexpr bool tracePairs = false;
+#endif
+
+	// markers around the stages of fitAll, for VTune with -DQWD0_ITT (and
+	// ittnotify on the include and library path) and for perf or SystemTap
+	// with -DQWD0_SDT (sys/sdt.h, probes qwd0:stage_begin and qwd0:stage_end
+	// with the stage as argument); compiled out by default
+#if defined(QWD0_ITT) || defined(QWD0_SDT)
+	constexpr bool stageMarkers = true;
+	void beginStageMarker(QWD0Cutflow::Stage stage);
+	void endStageMarker(QWD0Cutflow::Stage stage);
+#else
+	constexpr bool stageMarkers = false;
+	inline void beginStageMarker(QWD0Cutflow::Stage) {}
+	inline void endStageMarker(QWD0Cutflow::Stage) {}
+#endif
+}
+
+// Fills the cutflow of QWD0Fitter::fitAll, optionally times its stages and
+// histograms the cut variables. One instance lives in each stream's fitter,
+// so filling needs no synchronization; the streams are merged per
+// luminosity block and at the end of the job.
+class dso_hidden QWD0Monitor : public QWD0Cutflow {
+public:
+	enum Variable {
+		kDCAValue,
+		kMPiPiValue,
+		kVtxChi2Value,
+		kDecaySigXYValue,
+		kDecaySigXYZValue,
+		kCosThetaXYValue,
+		kCosThetaXYZValue,
+		kMassPKValue,
+		kMassKPValue,
+		nVariables
+	};
+
+	// Times consecutive stages of one scope: start() closes the running
+	// stage and opens the next one, the destructor closes the last one.
+	// Without timing and stage markers it does nothing.
+	class StageTimer {
+	public:
+		explicit StageTimer(QWD0Monitor & monitor) : monitor_(monitor.timing_ || qwd0::stageMarkers ? &monitor : nullptr), running_(false) {}
+		~StageTimer() { stop(); }
+		void start(Stage stage) {
+			if (!monitor_) return;
+			auto now = monitor_->timing_ ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+			if (running_) {
+				qwd0::endStageMarker(stage_);
+				if (monitor_->timing_) monitor_->addTime(stage_, now - start_);
+			}
+			qwd0::beginStageMarker(stage);
+			stage_ = stage;
+			start_ = now;
+			running_ = true;
+		}
+		void stop() {
+			if (!monitor_ || !running_) return;
+			qwd0::endStageMarker(stage_);
+			if (monitor_->timing_) monitor_->addTime(stage_, std::chrono::steady_clock::now() - start_);
+			running_ = false;
+		}
+	private:
+		QWD0Monitor * monitor_;
+		bool running_;
+		Stage stage_;
+		std::chrono::steady_clock::time_point start_;
+	};
+
+	explicit QWD0Monitor(bool fillHistograms = false, bool timing = false);
+
+	void countEvent(unsigned long nTracks, unsigned long nSelected) {
+		++nEvents_;
+		nTracks_ += nTracks;
+		nSelected_ += nSelected;
+	}
+	void countPair() { ++nPairs_; }
+	void countPairs(unsigned long n) { nPairs_ += n; }
+	void reject(Cut cut) { ++rejected_[cut]; }
+	void reject(Cut cut, unsigned long n) { rejected_[cut] += n; }
+	void countCandidate(unsigned ihyp) {
+		++nCandidates_;
+		if (ihyp >= hypothesisCandidates_.size()) hypothesisCandidates_.resize(ihyp + 1, 0);
+		++hypothesisCandidates_[ihyp];
+	}
+	void fill(Variable var, double x) {
+		if (fillHistograms_) histograms_[var].fill(x);
+	}
+
+	// keeps the histogramming and timing settings
+	void clear();
+	void merge(const QWD0Monitor & other);
+	// summary through the MessageLogger, the candidates by hypothesis label
+	void report(const std::string & category, const std::string & moduleLabel = "",
+			const std::vector<std::string> & hypothesisLabels = std::vector<std::string>()) const;
+
+	static const char * variableName(Variable var);
+
+private:
+	class Histogram {
+	public:
+		Histogram() : lo_(0.), hi_(1.) {}
+		Histogram(unsigned nBins, double lo, double hi) : lo_(lo), hi_(hi), counts_(nBins + 2, 0) {}
+		void fill(double x);
+		void clear();
+		void merge(const Histogram & other);
+		bool empty() const;
+		std::string print() const;
+	private:
+		double lo_;
+		double hi_;
+		// underflow, bins, overflow
+		std::vector<unsigned long long> counts_;
+	};
+
+	void addTime(Stage stage, std::chrono::steady_clock::duration dt) {
+		stageNanoseconds_[stage] += std::chrono::duration_cast<std::chrono::nanoseconds>(dt).count();
+		++stageCalls_[stage];
+	}
+
+	bool fillHistograms_;
+	bool timing_;
+	std::array<Histogram, nVariables> histograms_;
+	// candidates of each hypothesis, in the order of the fitter
+	std::vector<unsigned long long> hypothesisCandidates_;
+};
+
+// job-wide sum of the stream monitors, held as the producer's GlobalCache
+struct dso_hidden QWD0MonitorCache {
+	QWD0MonitorCache(bool fillHistograms, bool timing, bool storeCutflow, const std::string & moduleLabel) :
+		monitor(fillHistograms, timing), storeCutflow(storeCutflow), moduleLabel(moduleLabel) {}
+	// from QWD0Fitter::hypothesisLabels() of the producer, the D0 as "D0"
+	void setHypothesisLabels(const std::vector<std::string> & labels) const {
+		std::lock_guard<std::mutex> guard(mutex);
+		hypothesisLabels = labels;
+		if (!hypothesisLabels.empty()) hypothesisLabels[0] = "D0";
+	}
+	mutable std::mutex mutex;
+	mutable QWD0Monitor monitor;
+	// put the per-lumi QWD0Cutflow into the LuminosityBlock
+	const bool storeCutflow;
+	// tells several producers apart in the job summary
+	const std::string moduleLabel;
+	// "D0" and the labels of the extraHypotheses, for the summary
+	mutable std::vector<std::string> hypothesisLabels;
+};
+
+#endif
@@ -0,0 +1,340 @@
+#include "QWD0PairFilter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "FWCore/Utilities/interface/Exception.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define QWD0_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace {
+	const float piMassSquared = 0.13957018f*0.13957018f;
+	// absorbs the float rounding of the mass bounds, GeV
+	const float massPad = 0.001f;
+	// keeps the division finite for tracks without a valid PCA state
+	const float tiny = 1e-30f;
+
+	// the track the batch is paired with
+	struct First {
+		int charge;
+		float px;
+		float py;
+		float pt;
+		float pz;
+		float p2;
+		float ePi;
+		float cosTurn;
+		float sinTurn;
+	};
+
+	// mass window of one (mass1, mass2) assignment, with the energy of the first track
+	struct Assignment {
+		float mass1Sq;
+		float mass2Sq;
+		float minMassSq;
+		float maxMassSq;
+		float e1;
+	};
+
+	inline bool keepPair(const First & t1, const QWD0TrackCache & tracks, unsigned trdx2,
+			float maxMPiPiSq, const Assignment * assignments, unsigned nAssignments)
+	{
+		if (tracks.charge[trdx2] == 0) return false;
+		float ptt = t1.pt*tracks.pt[trdx2];
+		if (!(ptt > 0.f)) return true;
+
+		// cosine of the transverse opening angle at the PCA, and its range
+		// after both tracks turned by up to their turning bounds
+		float c = std::min(1.f, std::max(-1.f, (t1.px*tracks.px[trdx2] + t1.py*tracks.py[trdx2]) / std::max(ptt, tiny)));
+		float s = std::sqrt(std::max(0.f, 1.f - c*c));
+		float cosT = t1.cosTurn*tracks.cosTurn[trdx2] - t1.sinTurn*tracks.sinTurn[trdx2];
+		float sinT = t1.sinTurn*tracks.cosTurn[trdx2] + t1.cosTurn*tracks.sinTurn[trdx2];
+		bool wide = sinT <= 0.f;
+		float maxCos = (wide || c >= cosT) ? 1.f : c*cosT + s*sinT;
+		float minCos = (wide || c <= -cosT) ? -1.f : c*cosT - s*sinT;
+		float pzz = t1.pz*tracks.pz[trdx2];
+		float maxDot = ptt*maxCos + pzz;
+		float minDot = ptt*minCos + pzz;
+		if (maxDot < 0.f) return false;
+
+		float ePi2 = std::sqrt(tracks.p2[trdx2] + piMassSquared);
+		if (2.f*piMassSquared + 2.f*(t1.ePi*ePi2 - maxDot) > maxMPiPiSq) return false;
+
+		if (nAssignments == 0) return true;
+		for (unsigned ia = 0; ia < nAssignments; ++ia) {
+			const Assignment & a = assignments[ia];
+			float e12 = a.e1*std::sqrt(tracks.p2[trdx2] + a.mass2Sq);
+			float base = a.mass1Sq + a.mass2Sq;
+			if (base + 2.f*(e12 - minDot) >= a.minMassSq && base + 2.f*(e12 - maxDot) <= a.maxMassSq) return true;
+		}
+		return false;
+	}
+
+	// the kernels filter in[0, n) into out and return the survivors; the
+	// vector ones run the scalar loop on the remainder
+	unsigned filterScalar(const First & t1, const QWD0TrackCache & tracks, float maxMPiPiSq,
+			const Assignment * assignments, unsigned nAssignments, const unsigned * in, unsigned n, unsigned * out,
+			unsigned k = 0, unsigned nOut = 0)
+	{
+		for (; k < n; ++k) {
+			if (keepPair(t1, tracks, in[k], maxMPiPiSq, assignments, nAssignments)) out[nOut++] = in[k];
+		}
+		return nOut;
+	}
+
+#ifdef QWD0_X86_KERNELS
+	// compiled for AVX-512 whatever the build flags, only called if the CPU has it
+	__attribute__((target("avx512f")))
+	unsigned filterAVX512(const First & t1, const QWD0TrackCache & tracks, float maxMPiPiSq,
+			const Assignment * assignments, unsigned nAssignments, const unsigned * in, unsigned n, unsigned * out)
+	{
+		unsigned nOut = 0;
+		unsigned k = 0;
+		const __m512 zero = _mm512_setzero_ps();
+		const __m512 one = _mm512_set1_ps(1.f);
+		const __m512 minusOne = _mm512_set1_ps(-1.f);
+		const __m512 two = _mm512_set1_ps(2.f);
+		const __m512 vtiny = _mm512_set1_ps(tiny);
+		const __m512 px1 = _mm512_set1_ps(t1.px), py1 = _mm512_set1_ps(t1.py);
+		const __m512 pt1 = _mm512_set1_ps(t1.pt), pz1 = _mm512_set1_ps(t1.pz);
+		const __m512 ePi1 = _mm512_set1_ps(t1.ePi);
+		const __m512 ct1 = _mm512_set1_ps(t1.cosTurn), st1 = _mm512_set1_ps(t1.sinTurn);
+		const __m512 piSq = _mm512_set1_ps(piMassSquared);
+		const __m512 vmaxMPiPiSq = _mm512_set1_ps(maxMPiPiSq);
+
+		for (; k + 16 <= n; k += 16) {
+			__m512i idx = _mm512_loadu_si512(in + k);
+			__mmask16 chargeOK = _mm512_test_epi32_mask(_mm512_i32gather_epi32(idx, tracks.charge.data(), 4), _mm512_set1_epi32(-1));
+			__m512 px2 = _mm512_i32gather_ps(idx, tracks.px.data(), 4);
+			__m512 py2 = _mm512_i32gather_ps(idx, tracks.py.data(), 4);
+			__m512 pt2 = _mm512_i32gather_ps(idx, tracks.pt.data(), 4);
+			__m512 pz2 = _mm512_i32gather_ps(idx, tracks.pz.data(), 4);
+			__m512 p22 = _mm512_i32gather_ps(idx, tracks.p2.data(), 4);
+			__m512 ct2 = _mm512_i32gather_ps(idx, tracks.cosTurn.data(), 4);
+			__m512 st2 = _mm512_i32gather_ps(idx, tracks.sinTurn.data(), 4);
+
+			__m512 ptt = _mm512_mul_ps(pt1, pt2);
+			__mmask16 valid = _mm512_cmp_ps_mask(ptt, zero, _CMP_GT_OQ);
+			__m512 c = _mm512_div_ps(_mm512_add_ps(_mm512_mul_ps(px1, px2), _mm512_mul_ps(py1, py2)), _mm512_max_ps(ptt, vtiny));
+			c = _mm512_min_ps(one, _mm512_max_ps(minusOne, c));
+			__m512 s = _mm512_sqrt_ps(_mm512_max_ps(zero, _mm512_sub_ps(one, _mm512_mul_ps(c, c))));
+			__m512 cosT = _mm512_sub_ps(_mm512_mul_ps(ct1, ct2), _mm512_mul_ps(st1, st2));
+			__m512 sinT = _mm512_add_ps(_mm512_mul_ps(st1, ct2), _mm512_mul_ps(ct1, st2));
+			__mmask16 wide = _mm512_cmp_ps_mask(sinT, zero, _CMP_LE_OQ);
+			__m512 cc = _mm512_mul_ps(c, cosT);
+			__m512 ss = _mm512_mul_ps(s, sinT);
+			__mmask16 full = wide | _mm512_cmp_ps_mask(c, cosT, _CMP_GE_OQ);
+			__mmask16 back = wide | _mm512_cmp_ps_mask(c, _mm512_sub_ps(zero, cosT), _CMP_LE_OQ);
+			__m512 maxCos = _mm512_mask_blend_ps(full, _mm512_add_ps(cc, ss), one);
+			__m512 minCos = _mm512_mask_blend_ps(back, _mm512_sub_ps(cc, ss), minusOne);
+			__m512 pzz = _mm512_mul_ps(pz1, pz2);
+			__m512 maxDot = _mm512_add_ps(_mm512_mul_ps(ptt, maxCos), pzz);
+			__m512 minDot = _mm512_add_ps(_mm512_mul_ps(ptt, minCos), pzz);
+			__mmask16 pass = _mm512_cmp_ps_mask(maxDot, zero, _CMP_GE_OQ);
+
+			__m512 ePi2 = _mm512_sqrt_ps(_mm512_add_ps(p22, piSq));
+			__m512 mPiPiSq = _mm512_add_ps(_mm512_mul_ps(two, piSq), _mm512_mul_ps(two, _mm512_sub_ps(_mm512_mul_ps(ePi1, ePi2), maxDot)));
+			pass &= _mm512_cmp_ps_mask(mPiPiSq, vmaxMPiPiSq, _CMP_LE_OQ);
+
+			if (nAssignments > 0) {
+				__mmask16 passMass = 0;
+				for (unsigned ia = 0; ia < nAssignments; ++ia) {
+					const Assignment & a = assignments[ia];
+					__m512 e12 = _mm512_mul_ps(_mm512_set1_ps(a.e1), _mm512_sqrt_ps(_mm512_add_ps(p22, _mm512_set1_ps(a.mass2Sq))));
+					__m512 base = _mm512_set1_ps(a.mass1Sq + a.mass2Sq);
+					passMass |= _mm512_cmp_ps_mask(_mm512_add_ps(base, _mm512_mul_ps(two, _mm512_sub_ps(e12, minDot))), _mm512_set1_ps(a.minMassSq), _CMP_GE_OQ)
+						& _mm512_cmp_ps_mask(_mm512_add_ps(base, _mm512_mul_ps(two, _mm512_sub_ps(e12, maxDot))), _mm512_set1_ps(a.maxMassSq), _CMP_LE_OQ);
+				}
+				pass &= passMass;
+			}
+
+			__mmask16 keep = chargeOK & (pass | ~valid);
+			_mm512_mask_compressstoreu_epi32(out + nOut, keep, idx);
+			nOut += __builtin_popcount(keep);
+		}
+		return filterScalar(t1, tracks, maxMPiPiSq, assignments, nAssignments, in, n, out, k, nOut);
+	}
+
+	__attribute__((target("avx2")))
+	unsigned filterAVX2(const First & t1, const QWD0TrackCache & tracks, float maxMPiPiSq,
+			const Assignment * assignments, unsigned nAssignments, const unsigned * in, unsigned n, unsigned * out)
+	{
+		unsigned nOut = 0;
+		unsigned k = 0;
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 one = _mm256_set1_ps(1.f);
+		const __m256 minusOne = _mm256_set1_ps(-1.f);
+		const __m256 two = _mm256_set1_ps(2.f);
+		const __m256 vtiny = _mm256_set1_ps(tiny);
+		const __m256 px1 = _mm256_set1_ps(t1.px), py1 = _mm256_set1_ps(t1.py);
+		const __m256 pt1 = _mm256_set1_ps(t1.pt), pz1 = _mm256_set1_ps(t1.pz);
+		const __m256 ePi1 = _mm256_set1_ps(t1.ePi);
+		const __m256 ct1 = _mm256_set1_ps(t1.cosTurn), st1 = _mm256_set1_ps(t1.sinTurn);
+		const __m256 piSq = _mm256_set1_ps(piMassSquared);
+		const __m256 vmaxMPiPiSq = _mm256_set1_ps(maxMPiPiSq);
+
+		for (; k + 8 <= n; k += 8) {
+			__m256i idx = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + k));
+			__m256i q2 = _mm256_i32gather_epi32(tracks.charge.data(), idx, 4);
+			__m256 chargeOK = _mm256_castsi256_ps(_mm256_xor_si256(_mm256_cmpeq_epi32(q2, _mm256_setzero_si256()), _mm256_set1_epi32(-1)));
+			__m256 px2 = _mm256_i32gather_ps(tracks.px.data(), idx, 4);
+			__m256 py2 = _mm256_i32gather_ps(tracks.py.data(), idx, 4);
+			__m256 pt2 = _mm256_i32gather_ps(tracks.pt.data(), idx, 4);
+			__m256 pz2 = _mm256_i32gather_ps(tracks.pz.data(), idx, 4);
+			__m256 p22 = _mm256_i32gather_ps(tracks.p2.data(), idx, 4);
+			__m256 ct2 = _mm256_i32gather_ps(tracks.cosTurn.data(), idx, 4);
+			__m256 st2 = _mm256_i32gather_ps(tracks.sinTurn.data(), idx, 4);
+
+			__m256 ptt = _mm256_mul_ps(pt1, pt2);
+			__m256 valid = _mm256_cmp_ps(ptt, zero, _CMP_GT_OQ);
+			__m256 c = _mm256_div_ps(_mm256_add_ps(_mm256_mul_ps(px1, px2), _mm256_mul_ps(py1, py2)), _mm256_max_ps(ptt, vtiny));
+			c = _mm256_min_ps(one, _mm256_max_ps(minusOne, c));
+			__m256 s = _mm256_sqrt_ps(_mm256_max_ps(zero, _mm256_sub_ps(one, _mm256_mul_ps(c, c))));
+			__m256 cosT = _mm256_sub_ps(_mm256_mul_ps(ct1, ct2), _mm256_mul_ps(st1, st2));
+			__m256 sinT = _mm256_add_ps(_mm256_mul_ps(st1, ct2), _mm256_mul_ps(ct1, st2));
+			__m256 wide = _mm256_cmp_ps(sinT, zero, _CMP_LE_OQ);
+			__m256 cc = _mm256_mul_ps(c, cosT);
+			__m256 ss = _mm256_mul_ps(s, sinT);
+			__m256 full = _mm256_or_ps(wide, _mm256_cmp_ps(c, cosT, _CMP_GE_OQ));
+			__m256 back = _mm256_or_ps(wide, _mm256_cmp_ps(c, _mm256_sub_ps(zero, cosT), _CMP_LE_OQ));
+			__m256 maxCos = _mm256_blendv_ps(_mm256_add_ps(cc, ss), one, full);
+			__m256 minCos = _mm256_blendv_ps(_mm256_sub_ps(cc, ss), minusOne, back);
+			__m256 pzz = _mm256_mul_ps(pz1, pz2);
+			__m256 maxDot = _mm256_add_ps(_mm256_mul_ps(ptt, maxCos), pzz);
+			__m256 minDot = _mm256_add_ps(_mm256_mul_ps(ptt, minCos), pzz);
+			__m256 pass = _mm256_cmp_ps(maxDot, zero, _CMP_GE_OQ);
+
+			__m256 ePi2 = _mm256_sqrt_ps(_mm256_add_ps(p22, piSq));
+			__m256 mPiPiSq = _mm256_add_ps(_mm256_mul_ps(two, piSq), _mm256_mul_ps(two, _mm256_sub_ps(_mm256_mul_ps(ePi1, ePi2), maxDot)));
+			pass = _mm256_and_ps(pass, _mm256_cmp_ps(mPiPiSq, vmaxMPiPiSq, _CMP_LE_OQ));
+
+			if (nAssignments > 0) {
+				__m256 passMass = zero;
+				for (unsigned ia = 0; ia < nAssignments; ++ia) {
+					const Assignment & a = assignments[ia];
+					__m256 e12 = _mm256_mul_ps(_mm256_set1_ps(a.e1), _mm256_sqrt_ps(_mm256_add_ps(p22, _mm256_set1_ps(a.mass2Sq))));
+					__m256 base = _mm256_set1_ps(a.mass1Sq + a.mass2Sq);
+					passMass = _mm256_or_ps(passMass, _mm256_and_ps(
+							_mm256_cmp_ps(_mm256_add_ps(base, _mm256_mul_ps(two, _mm256_sub_ps(e12, minDot))), _mm256_set1_ps(a.minMassSq), _CMP_GE_OQ),
+							_mm256_cmp_ps(_mm256_add_ps(base, _mm256_mul_ps(two, _mm256_sub_ps(e12, maxDot))), _mm256_set1_ps(a.maxMassSq), _CMP_LE_OQ)));
+				}
+				pass = _mm256_and_ps(pass, passMass);
+			}
+
+			__m256 keep = _mm256_and_ps(chargeOK, _mm256_or_ps(pass, _mm256_andnot_ps(valid, _mm256_castsi256_ps(_mm256_set1_epi32(-1)))));
+			unsigned mask = _mm256_movemask_ps(keep);
+			while (mask) {
+				out[nOut++] = in[k + __builtin_ctz(mask)];
+				mask &= mask - 1;
+			}
+		}
+		return filterScalar(t1, tracks, maxMPiPiSq, assignments, nAssignments, in, n, out, k, nOut);
+	}
+#endif
+}
+
+QWD0PairFilter::QWD0PairFilter() :
+	kernel_(bestKernel())
+{
+	setMPiPiCut(-1.);
+}
+
+bool QWD0PairFilter::supported(Kernel kernel)
+{
+#ifdef QWD0_X86_KERNELS
+	__builtin_cpu_init();
+	switch (kernel) {
+		case kScalarKernel: return true;
+		case kAVX2Kernel: return __builtin_cpu_supports("avx2");
+		case kAVX512Kernel: return __builtin_cpu_supports("avx512f");
+		default: return false;
+	}
+#else
+	return kernel == kScalarKernel;
+#endif
+}
+
+QWD0PairFilter::Kernel QWD0PairFilter::bestKernel()
+{
+	if (supported(kAVX512Kernel)) return kAVX512Kernel;
+	if (supported(kAVX2Kernel)) return kAVX2Kernel;
+	return kScalarKernel;
+}
+
+void QWD0PairFilter::setKernel(Kernel kernel)
+{
+	if (!supported(kernel)) {
+		throw cms::Exception("Configuration") << "QWD0PairFilter: the " << kernelName(kernel) << " kernel is not supported by this CPU";
+	}
+	kernel_ = kernel;
+}
+
+void QWD0PairFilter::setMPiPiCut(double maxMPiPi)
+{
+	maxMPiPiSq_ = maxMPiPi < 0. ? std::numeric_limits<float>::max() : (maxMPiPi + massPad)*(maxMPiPi + massPad);
+}
+
+void QWD0PairFilter::addMassWindow(double mass1, double mass2, double mass, double window)
+{
+	if (windows_.size() == maxWindows) {
+		throw cms::Exception("Configuration") << "QWD0PairFilter: more than " << maxWindows << " mass windows";
+	}
+	float lo = std::max(0.f, float(mass - window) - massPad);
+	float hi = float(mass + window) + massPad;
+	windows_.push_back(Window{float(mass1*mass1), float(mass2*mass2), lo*lo, hi*hi});
+}
+
+const char * QWD0PairFilter::kernelName(Kernel kernel)
+{
+	switch (kernel) {
+		case kScalarKernel: return "scalar";
+		case kAVX2Kernel: return "AVX2";
+		case kAVX512Kernel: return "AVX-512";
+		default: return "unknown";
+	}
+}
+
+unsigned QWD0PairFilter::filter(const QWD0TrackCache & tracks, unsigned trdx1,
+		const std::vector<unsigned> & partners, std::vector<unsigned> & survivors) const
+{
+	survivors.resize(partners.size());
+	unsigned nOut = filter(tracks, trdx1, partners.data(), partners.size(), survivors.data());
+	survivors.resize(nOut);
+	return nOut;
+}
+
+unsigned QWD0PairFilter::filter(const QWD0TrackCache & tracks, unsigned trdx1,
+		const unsigned * in, unsigned n, unsigned * out) const
+{
+	if (n == 0 || tracks.charge[trdx1] == 0) return 0;
+
+	First t1;
+	t1.charge = tracks.charge[trdx1];
+	t1.px = tracks.px[trdx1];
+	t1.py = tracks.py[trdx1];
+	t1.pt = tracks.pt[trdx1];
+	t1.pz = tracks.pz[trdx1];
+	t1.p2 = tracks.p2[trdx1];
+	t1.ePi = std::sqrt(t1.p2 + piMassSquared);
+	t1.cosTurn = tracks.cosTurn[trdx1];
+	t1.sinTurn = tracks.sinTurn[trdx1];
+
+	Assignment assignments[maxWindows];
+	const unsigned nAssignments = windows_.size();
+	for (unsigned ia = 0; ia < nAssignments; ++ia) {
+		const Window & w = windows_[ia];
+		assignments[ia] = Assignment{w.mass1Sq, w.mass2Sq, w.minMassSq, w.maxMassSq, std::sqrt(t1.p2 + w.mass1Sq)};
+	}
+
+	switch (kernel_) {
+#ifdef QWD0_X86_KERNELS
+		case kAVX512Kernel: return filterAVX512(t1, tracks, maxMPiPiSq_, assignments, nAssignments, in, n, out);
+		case kAVX2Kernel: return filterAVX2(t1, tracks, maxMPiPiSq_, assignments, nAssignments, in, n, out);
+#endif
+		default: return filterScalar(t1, tracks, maxMPiPiSq_, assignments, nAssignments, in, n, out);
+	}
+}
@@ -0,0 +1,66 @@
+#ifndef QWD0_PAIRFILTER_H
+#define QWD0_PAIRFILTER_H
+
+#include <vector>
+
+#include "QWD0TrackCache.h"
+
+// Batched pre-fit filter of one track against its candidate partners, run
+// before any ClosestApproachInRPhi or TSCP propagation in QWD0Fitter::fitAll.
+// From the momenta at the PCA and the turning bounds of QWD0TrackCache it
+// bounds the momentum dot product anywhere inside the fiducial volume; |p| is
+// conserved along the helix, so the energies are exact. A pair is dropped
+// only if it can not pass
+//  - the charge requirement,
+//  - the same-quadrant requirement (the dot product is negative everywhere),
+//  - the mPiPi cut, if set,
+//  - the pre-fit mass windows, if any are set: the pair may pass if one of
+//    the (mass1, mass2) assignments may end up inside its window,
+// so the survivors are a superset of the pairs passing those cuts at the
+// crossing point and the output does not depend on which kernel is used.
+// Tracks without a valid impactPointTSCP are passed on.
+// The AVX-512 and AVX2 kernels are built whatever the compiler flags and the
+// best one the CPU supports is picked at run time, or the scalar loop.
+class dso_hidden QWD0PairFilter {
+public:
+	enum Kernel { kScalarKernel, kAVX2Kernel, kAVX512Kernel };
+
+	QWD0PairFilter();
+
+	// throws if the CPU does not support the kernel
+	void setKernel(Kernel kernel);
+	Kernel kernel() const { return kernel_; }
+	static bool supported(Kernel kernel);
+	static Kernel bestKernel();
+	static const char * kernelName(Kernel kernel);
+
+	// < 0 disables the cut
+	void setMPiPiCut(double maxMPiPi);
+	// pair mass within window of mass with the first track as mass1 and the
+	// second as mass2; without windows the mass is not checked
+	void clearMassWindows() { windows_.clear(); }
+	void addMassWindow(double mass1, double mass2, double mass, double window);
+	static const unsigned maxWindows = 16;
+
+	// writes the partners of trdx1 that may pass into survivors and returns their number
+	unsigned filter(const QWD0TrackCache & tracks, unsigned trdx1,
+			const std::vector<unsigned> & partners, std::vector<unsigned> & survivors) const;
+
+private:
+	// one partner list
+	unsigned filter(const QWD0TrackCache & tracks, unsigned trdx1, const unsigned * in, unsigned n, unsigned * out) const;
+
+	struct Window {
+		float mass1Sq;
+		float mass2Sq;
+		float minMassSq;
+		float maxMassSq;
+	};
+
+	Kernel kernel_;
+	// squared bound, +inf when the cut is disabled
+	float maxMPiPiSq_;
+	std::vector<Window> windows_;
+};
+
+#endif
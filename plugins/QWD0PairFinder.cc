@@ -0,0 +1,133 @@
+#include "QWD0PairFinder.h"
+
+#include <cmath>
+
+namespace {
+	// eta range covered by the bins, tracks beyond go to the outermost bins
+	const double etaEdge = 2.5;
+}
+
+QWD0PairFinder::QWD0PairFinder(double maxRadius, unsigned nPhiBins, unsigned nEtaBins) :
+	maxRadius_(maxRadius),
+	nPhiBins_(nPhiBins),
+	nEtaBins_(nEtaBins),
+	maxDCA_(-1.),
+	charges_(kBothSigns),
+	bins_(nPhiBins*nEtaBins),
+	neighbours_(nPhiBins*nEtaBins)
+{
+}
+
+void QWD0PairFinder::clear()
+{
+	for (unsigned ibin : usedBins_) {
+		bins_[ibin].tracks[0].clear();
+		bins_[ibin].tracks[1].clear();
+		neighbours_[ibin].clear();
+	}
+	usedBins_.clear();
+	helices_.clear();
+}
+
+void QWD0PairFinder::build(const QWD0TrackCache & tracks)
+{
+	clear();
+	helices_.resize(tracks.size());
+	for (unsigned trdx = 0; trdx < tracks.size(); ++trdx) {
+		Helix & h = helices_[trdx];
+		h.valid = tracks.valid[trdx] && tracks.charge[trdx] != 0;
+		h.sign = tracks.charge[trdx] > 0 ? 1 : 0;
+		h.bin = 0;
+		if (!h.valid) continue;
+
+		h.phi = tracks.phi[trdx];
+		h.sinhEta = tracks.pz[trdx] / tracks.pt[trdx];
+		h.z0 = tracks.z0[trdx];
+		h.turn = tracks.turn[trdx];
+		h.arcZ = tracks.arcZ[trdx];
+
+		// phi is stored as float and may round just outside [-pi, pi]
+		unsigned iphi = std::min(nPhiBins_ - 1, unsigned(std::max(0., (h.phi + M_PI) / (2.*M_PI) * nPhiBins_)));
+		double eta = std::max(-etaEdge, std::min(etaEdge, double(tracks.eta[trdx])));
+		unsigned ieta = std::min(nEtaBins_ - 1, unsigned((eta + etaEdge) / (2.*etaEdge) * nEtaBins_));
+		h.bin = iphi*nEtaBins_ + ieta;
+
+		Bin & bin = bins_[h.bin];
+		if (bin.tracks[0].empty() && bin.tracks[1].empty()) {
+			usedBins_.push_back(h.bin);
+			bin.sinhEtaMin = bin.sinhEtaMax = h.sinhEta;
+			bin.z0Min = bin.z0Max = h.z0;
+			bin.turnMax = h.turn;
+			bin.arcZMax = h.arcZ;
+		} else {
+			bin.sinhEtaMin = std::min(bin.sinhEtaMin, h.sinhEta);
+			bin.sinhEtaMax = std::max(bin.sinhEtaMax, h.sinhEta);
+			bin.z0Min = std::min(bin.z0Min, h.z0);
+			bin.z0Max = std::max(bin.z0Max, h.z0);
+			bin.turnMax = std::max(bin.turnMax, h.turn);
+			bin.arcZMax = std::max(bin.arcZMax, h.arcZ);
+		}
+		bin.tracks[h.sign].push_back(trdx);
+	}
+
+	for (unsigned ibin1 : usedBins_) {
+		for (unsigned ibin2 : usedBins_) {
+			if (compatible(ibin1, ibin2)) neighbours_[ibin1].push_back(ibin2);
+		}
+	}
+}
+
+void QWD0PairFinder::partners(unsigned trdx1, std::vector<unsigned> & out) const
+{
+	out.clear();
+	const Helix & h1 = helices_[trdx1];
+	if (!h1.valid) return;
+
+	for (unsigned ibin : neighbours_[h1.bin]) {
+		for (unsigned sign = 0; sign < 2; ++sign) {
+			if (charges_ == kOppositeSign && sign == h1.sign) continue;
+			if (charges_ == kSameSign && sign != h1.sign) continue;
+			const std::vector<unsigned> & tracks = bins_[ibin].tracks[sign];
+			for (auto it = std::upper_bound(tracks.begin(), tracks.end(), trdx1); it != tracks.end(); ++it) {
+				if (compatible(h1, helices_[*it])) out.push_back(*it);
+			}
+		}
+	}
+	std::sort(out.begin(), out.end());
+}
+
+bool QWD0PairFinder::pass(double dPhi, double turn, double sinhEtaProd, double dz, double arcZ) const
+{
+	// p1.p2 / (pt1*pt2) = cos(dPhi) + sinhEta1*sinhEta2 at the best possible dPhi
+	double open = dPhi - turn;
+	double cosMax = open <= 0. ? 1. : (open >= M_PI ? -1. : std::cos(open));
+	if (cosMax + sinhEtaProd < 0.) return false;
+
+	if (maxDCA_ >= 0. && dz - arcZ > maxDCA_) return false;
+	return true;
+}
+
+bool QWD0PairFinder::compatible(const Helix & h1, const Helix & h2) const
+{
+	double dPhi = std::abs(h1.phi - h2.phi);
+	if (dPhi > M_PI) dPhi = 2.*M_PI - dPhi;
+	return pass(dPhi, h1.turn + h2.turn, h1.sinhEta*h2.sinhEta, std::abs(h1.z0 - h2.z0), h1.arcZ + h2.arcZ);
+}
+
+bool QWD0PairFinder::compatible(unsigned ibin1, unsigned ibin2) const
+{
+	const Bin & b1 = bins_[ibin1];
+	const Bin & b2 = bins_[ibin2];
+
+	unsigned iphi1 = ibin1 / nEtaBins_;
+	unsigned iphi2 = ibin2 / nEtaBins_;
+	unsigned k = iphi1 > iphi2 ? iphi1 - iphi2 : iphi2 - iphi1;
+	k = std::min(k, nPhiBins_ - k);
+	double dPhi = k > 0 ? (k - 1) * 2.*M_PI / nPhiBins_ : 0.;
+
+	double sinhEtaProd = std::max(std::max(b1.sinhEtaMin*b2.sinhEtaMin, b1.sinhEtaMin*b2.sinhEtaMax),
+			std::max(b1.sinhEtaMax*b2.sinhEtaMin, b1.sinhEtaMax*b2.sinhEtaMax));
+	double dz = std::max(0., std::max(b2.z0Min - b1.z0Max, b1.z0Min - b2.z0Max));
+
+	return pass(dPhi, b1.turnMax + b2.turnMax, sinhEtaProd, dz, b1.arcZMax + b2.arcZMax);
+}
@@ -0,0 +1,86 @@
+#ifndef QWD0_PAIRFINDER_H
+#define QWD0_PAIRFINDER_H
+
+#include <vector>
+#include <algorithm>
+
+#include "QWD0TrackCache.h"
+
+// Generates the track pairs vertexed by QWD0Fitter::fitAll.
+// Preselected tracks are binned in (phi, eta) of their momentum at the PCA to
+// the origin. In a uniform field a helix can only turn by a bounded angle
+// before it leaves the fiducial volume (QWD0TrackCache::computeTurnBounds),
+// so a pair of bins (and then a pair of tracks) is skipped only if the two
+// momenta can not point in the same quadrant anywhere inside it, or, if a DCA
+// cut is set, if their z can not come closer than that cut. The bounds are
+// padded for the real field map, so the emitted pairs are a superset of the
+// pairs passing those requirements.
+// Pairs are emitted in the same (trdx1 < trdx2) order as the brute-force loop.
+class dso_hidden QWD0PairFinder {
+public:
+	// which charge combinations are paired; tracks without charge are
+	// only paired (and then rejected) by the brute-force loop
+	enum ChargeCombination {
+		kOppositeSign,
+		kSameSign,
+		kBothSigns
+	};
+
+	QWD0PairFinder(double maxRadius, unsigned nPhiBins = 32, unsigned nEtaBins = 10);
+
+	void setChargeCombination(ChargeCombination charges) { charges_ = charges; }
+	ChargeCombination chargeCombination() const { return charges_; }
+
+	// POCA distance cut the pairs have to be able to pass, < 0 disables the dz window
+	void setMaxDCA(double maxDCA) { maxDCA_ = maxDCA; }
+	// bin the preselected tracks of the event, tracks without a valid
+	// impactPointTSCP never enter a pair; needs computeTurnBounds
+	void build(const QWD0TrackCache & tracks);
+
+	// the sorted trdx2 > trdx1 compatible with trdx1, safe to call concurrently
+	void partners(unsigned trdx1, std::vector<unsigned> & out) const;
+
+private:
+	struct Helix {
+		bool valid;
+		// 0 for negative, 1 for positive tracks
+		unsigned sign;
+		unsigned bin;
+		double phi;
+		// pz/pt, constant along the helix
+		double sinhEta;
+		double z0;
+		// largest turning angle and |dz| travelled until the fiducial radius is reached
+		double turn;
+		double arcZ;
+	};
+
+	struct Bin {
+		// negative and positive tracks
+		std::vector<unsigned> tracks[2];
+		double sinhEtaMin;
+		double sinhEtaMax;
+		double z0Min;
+		double z0Max;
+		double turnMax;
+		double arcZMax;
+	};
+
+	void clear();
+	bool compatible(const Helix & h1, const Helix & h2) const;
+	bool compatible(unsigned bin1, unsigned bin2) const;
+	bool pass(double dPhi, double turn, double sinhEtaProd, double dz, double arcZ) const;
+
+	double maxRadius_;
+	unsigned nPhiBins_;
+	unsigned nEtaBins_;
+	double maxDCA_;
+	ChargeCombination charges_;
+
+	std::vector<Helix> helices_;
+	std::vector<Bin> bins_;
+	std::vector<unsigned> usedBins_;
+	std::vector<std::vector<unsigned>> neighbours_;
+};
+
+#endif
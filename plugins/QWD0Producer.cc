@@ -0,0 +1,286 @@
+#include <cctype>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// user include files
+#include "FWCore/Framework/interface/Frameworkfwd.h"
+#include "FWCore/Framework/interface/stream/EDProducer.h"
+#include "FWCore/Framework/interface/global/EDProducer.h"
+
+#include "FWCore/Framework/interface/Event.h"
+#include "FWCore/Framework/interface/LuminosityBlock.h"
+#include "FWCore/Framework/interface/MakerMacros.h"
+
+#include "FWCore/ParameterSet/interface/ParameterSet.h"
+#include "FWCore/MessageLogger/interface/MessageLogger.h"
+
+#include "FWCore/Framework/interface/ESHandle.h"
+
+#include "DataFormats/VertexReco/interface/Vertex.h"
+#include "DataFormats/Candidate/interface/VertexCompositeCandidate.h"
+#include "DataFormats/Common/interface/ValueMap.h"
+
+#include "QWAna/QWD0Producer/interface/QWD0Cutflow.h"
+#include "QWAna/QWD0Producer/interface/QWD0FittedPair.h"
+#include "QWAna/QWD0Producer/interface/QWD0CompactCandidates.h"
+#include "QWAna/QWD0Producer/interface/QWD0ThrottleInfo.h"
+#include "QWAna/QWD0Producer/interface/QWD0StageTimes.h"
+#include "QWD0Fitter.h"
+
+namespace {
+	// instance label of a ValueMap: the variable name for the D0, else the
+	// hypothesis label followed by the capitalized variable name
+	std::string variableLabel(const std::string & label, QWD0Fitter::Variable var) {
+		std::string name = QWD0Fitter::variableName(var);
+		if (label.empty()) return name;
+		name[0] = std::toupper(name[0]);
+		return label + name;
+	}
+
+	// write the collections of all hypotheses to the Event
+	void putOutput(edm::Event& iEvent, const QWD0Fitter & theVees, QWD0Fitter::Output & output) {
+		const std::vector<std::string> labels = theVees.hypothesisLabels();
+		for (unsigned ihyp = 0; ihyp < labels.size(); ++ihyp) {
+			if (theVees.storeCandidates()) {
+				std::auto_ptr< reco::VertexCompositeCandidateCollection > cands(
+						new reco::VertexCompositeCandidateCollection(std::move(output.candidates[ihyp])) );
+				LogDebug("QWD0Producer") << "put '" << labels[ihyp] << "' candidates " << cands->size();
+				edm::OrphanHandle< reco::VertexCompositeCandidateCollection > candsHandle = iEvent.put( cands, labels[ihyp] );
+
+				// the selection variables keyed to the candidates just put
+				for (unsigned ivar = 0; ivar < QWD0Fitter::nVariables; ++ivar) {
+					if (!theVees.storeVariable(QWD0Fitter::Variable(ivar))) continue;
+					const std::vector<float> & values = output.variables[ihyp][ivar];
+					std::auto_ptr< edm::ValueMap<float> > valueMap( new edm::ValueMap<float> );
+					edm::ValueMap<float>::Filler filler(*valueMap);
+					filler.insert(candsHandle, values.begin(), values.end());
+					filler.fill();
+					iEvent.put( valueMap, variableLabel(labels[ihyp], QWD0Fitter::Variable(ivar)) );
+				}
+			}
+			if (theVees.storeCompactCandidates()) {
+				LogDebug("QWD0Producer") << "put '" << labels[ihyp] << "' compact candidates " << output.compactCandidates[ihyp].size();
+				iEvent.put( std::auto_ptr<QWD0CompactCandidates>(new QWD0CompactCandidates(std::move(output.compactCandidates[ihyp]))), labels[ihyp] );
+			}
+		}
+		if (theVees.storeFittedPairs()) {
+			LogDebug("QWD0Producer") << "put fitted pairs " << output.fittedPairs.size();
+			iEvent.put( std::auto_ptr<QWD0FittedPairCollection>(new QWD0FittedPairCollection(std::move(output.fittedPairs))) );
+		}
+		if (theVees.throttled()) {
+			iEvent.put( std::auto_ptr<QWD0ThrottleInfo>(new QWD0ThrottleInfo(output.throttle)) );
+		}
+		if (theVees.storeStageTimes()) {
+			iEvent.put( std::auto_ptr<QWD0StageTimes>(new QWD0StageTimes(output.stageTimes)) );
+		}
+	}
+}
+
+class dso_hidden QWD0Producer final : public edm::stream::EDProducer<
+		edm::GlobalCache<QWD0MonitorCache>,
+		edm::LuminosityBlockSummaryCache<QWD0Cutflow>,
+		edm::EndLuminosityBlockProducer> {
+public:
+	QWD0Producer(const edm::ParameterSet&, const QWD0MonitorCache*);
+
+	static std::unique_ptr<QWD0MonitorCache> initializeGlobalCache(const edm::ParameterSet&);
+	static void globalEndJob(const QWD0MonitorCache*);
+
+	static std::shared_ptr<QWD0Cutflow> globalBeginLuminosityBlockSummary(const edm::LuminosityBlock&, const edm::EventSetup&, const LuminosityBlockContext*);
+	static void globalEndLuminosityBlockSummary(const edm::LuminosityBlock&, const edm::EventSetup&, const LuminosityBlockContext*, QWD0Cutflow*);
+	static void globalEndLuminosityBlockProduce(edm::LuminosityBlock&, const edm::EventSetup&, const LuminosityBlockContext*, const QWD0Cutflow*);
+
+private:
+	void produce(edm::Event&, const edm::EventSetup&) override;
+	void beginLuminosityBlock(const edm::LuminosityBlock&, const edm::EventSetup&) override;
+	void endLuminosityBlockSummary(const edm::LuminosityBlock&, const edm::EventSetup&, QWD0Cutflow*) const override;
+	void endStream() override;
+
+	QWD0Fitter theVees;
+	std::unique_ptr<QWD0Fitter::Workspace> theWorkspace;
+	// this stream's monitor of the luminosity blocks already summarized
+	QWD0Monitor theStreamMonitor;
+};
+
+
+// Constructor
+QWD0Producer::QWD0Producer(const edm::ParameterSet& iConfig, const QWD0MonitorCache* cache) :
+	theVees(iConfig, consumesCollector()),
+	theWorkspace(theVees.makeWorkspace()),
+	theStreamMonitor(iConfig.getUntrackedParameter<bool>("monitorHistograms", false),
+			iConfig.getUntrackedParameter<bool>("monitorTiming", false))
+{
+	// one collection per hypothesis, the D0 keeps the unlabelled product
+	for (const std::string & label : theVees.hypothesisLabels()) {
+		if (theVees.storeCandidates()) produces< reco::VertexCompositeCandidateCollection >(label);
+		for (unsigned ivar = 0; theVees.storeCandidates() && ivar < QWD0Fitter::nVariables; ++ivar) {
+			if (theVees.storeVariable(QWD0Fitter::Variable(ivar))) produces< edm::ValueMap<float> >(variableLabel(label, QWD0Fitter::Variable(ivar)));
+		}
+		if (theVees.storeCompactCandidates()) produces< QWD0CompactCandidates >(label);
+	}
+	if (theVees.storeFittedPairs()) produces< QWD0FittedPairCollection >();
+	if (theVees.throttled()) produces< QWD0ThrottleInfo >();
+	if (theVees.storeStageTimes()) produces< QWD0StageTimes >();
+	if (cache->storeCutflow) produces< QWD0Cutflow, edm::InLumi >();
+	// every stream has the same hypotheses
+	cache->setHypothesisLabels(theVees.hypothesisLabels());
+}
+
+std::unique_ptr<QWD0MonitorCache> QWD0Producer::initializeGlobalCache(const edm::ParameterSet& iConfig)
+{
+	return std::unique_ptr<QWD0MonitorCache>(new QWD0MonitorCache(
+			iConfig.getUntrackedParameter<bool>("monitorHistograms", false),
+			iConfig.getUntrackedParameter<bool>("monitorTiming", false),
+			iConfig.getParameter<bool>("storeCutflow"),
+			iConfig.getParameter<std::string>("@module_label")));
+}
+
+
+//
+// Methods
+//
+
+// Producer Method
+void QWD0Producer::produce(edm::Event& iEvent, const edm::EventSetup& iSetup) {
+	using namespace edm;
+
+	QWD0Fitter::Output output;
+
+	// invoke the fitter which reconstructs the vertices and fills
+	// the collections of all hypotheses from the same pairs
+	theVees.fitAll(iEvent, iSetup, *theWorkspace, output);
+
+	putOutput(iEvent, theVees, output);
+}
+
+// the fitter monitor only counts the current luminosity block
+void QWD0Producer::beginLuminosityBlock(const edm::LuminosityBlock&, const edm::EventSetup&) {
+	theStreamMonitor.merge(theWorkspace->monitor());
+	theWorkspace->monitor().clear();
+}
+
+// the framework serializes the calls for one summary
+void QWD0Producer::endLuminosityBlockSummary(const edm::LuminosityBlock&, const edm::EventSetup&, QWD0Cutflow* cutflow) const {
+	cutflow->mergeProduct(theWorkspace->monitor());
+}
+
+std::shared_ptr<QWD0Cutflow> QWD0Producer::globalBeginLuminosityBlockSummary(const edm::LuminosityBlock&, const edm::EventSetup&, const LuminosityBlockContext*) {
+	return std::make_shared<QWD0Cutflow>();
+}
+
+void QWD0Producer::globalEndLuminosityBlockSummary(const edm::LuminosityBlock&, const edm::EventSetup&, const LuminosityBlockContext*, QWD0Cutflow*) {
+}
+
+void QWD0Producer::globalEndLuminosityBlockProduce(edm::LuminosityBlock& iLumi, const edm::EventSetup&, const LuminosityBlockContext* context, const QWD0Cutflow* cutflow) {
+	if (!context->global()->storeCutflow) return;
+	iLumi.put( std::auto_ptr<QWD0Cutflow>(new QWD0Cutflow(*cutflow)) );
+}
+
+// add this stream's cut summary to the job summary
+void QWD0Producer::endStream() {
+	theStreamMonitor.merge(theWorkspace->monitor());
+	theWorkspace->monitor().clear();
+	std::lock_guard<std::mutex> guard(globalCache()->mutex);
+	globalCache()->monitor.merge(theStreamMonitor);
+}
+
+void QWD0Producer::globalEndJob(const QWD0MonitorCache* cache) {
+	cache->monitor.report("QWD0Producer", cache->moduleLabel, cache->hypothesisLabels);
+}
+
+
+// The same products from one QWD0Fitter shared by all streams, each stream
+// fits its events in its own workspace.
+class dso_hidden QWD0GlobalProducer final : public edm::global::EDProducer<
+		edm::StreamCache<QWD0Fitter::Workspace>,
+		edm::LuminosityBlockSummaryCache<QWD0Cutflow>,
+		edm::EndLuminosityBlockProducer> {
+public:
+	explicit QWD0GlobalProducer(const edm::ParameterSet&);
+
+private:
+	std::unique_ptr<QWD0Fitter::Workspace> beginStream(edm::StreamID) const override;
+	void produce(edm::StreamID, edm::Event&, const edm::EventSetup&) const override;
+	void streamBeginLuminosityBlock(edm::StreamID, const edm::LuminosityBlock&, const edm::EventSetup&) const override;
+	void streamEndLuminosityBlockSummary(edm::StreamID, const edm::LuminosityBlock&, const edm::EventSetup&, QWD0Cutflow*) const override;
+	std::shared_ptr<QWD0Cutflow> globalBeginLuminosityBlockSummary(const edm::LuminosityBlock&, const edm::EventSetup&) const override;
+	void globalEndLuminosityBlockSummary(const edm::LuminosityBlock&, const edm::EventSetup&, QWD0Cutflow*) const override;
+	void globalEndLuminosityBlockProduce(edm::LuminosityBlock&, const edm::EventSetup&, const QWD0Cutflow*) const override;
+	void endStream(edm::StreamID) const override;
+	void endJob() override;
+
+	const QWD0Fitter theVees;
+	// the luminosity blocks already summarized, of all streams
+	const std::unique_ptr<QWD0MonitorCache> theMonitorCache;
+};
+
+QWD0GlobalProducer::QWD0GlobalProducer(const edm::ParameterSet& iConfig) :
+	theVees(iConfig, consumesCollector()),
+	theMonitorCache(QWD0Producer::initializeGlobalCache(iConfig))
+{
+	for (const std::string & label : theVees.hypothesisLabels()) {
+		if (theVees.storeCandidates()) produces< reco::VertexCompositeCandidateCollection >(label);
+		for (unsigned ivar = 0; theVees.storeCandidates() && ivar < QWD0Fitter::nVariables; ++ivar) {
+			if (theVees.storeVariable(QWD0Fitter::Variable(ivar))) produces< edm::ValueMap<float> >(variableLabel(label, QWD0Fitter::Variable(ivar)));
+		}
+		if (theVees.storeCompactCandidates()) produces< QWD0CompactCandidates >(label);
+	}
+	if (theVees.storeFittedPairs()) produces< QWD0FittedPairCollection >();
+	if (theVees.throttled()) produces< QWD0ThrottleInfo >();
+	if (theVees.storeStageTimes()) produces< QWD0StageTimes >();
+	if (theMonitorCache->storeCutflow) produces< QWD0Cutflow, edm::InLumi >();
+	theMonitorCache->setHypothesisLabels(theVees.hypothesisLabels());
+}
+
+std::unique_ptr<QWD0Fitter::Workspace> QWD0GlobalProducer::beginStream(edm::StreamID) const {
+	return theVees.makeWorkspace();
+}
+
+void QWD0GlobalProducer::produce(edm::StreamID iStream, edm::Event& iEvent, const edm::EventSetup& iSetup) const {
+	QWD0Fitter::Output output;
+	theVees.fitAll(iEvent, iSetup, *streamCache(iStream), output);
+	putOutput(iEvent, theVees, output);
+}
+
+// the workspace monitor only counts the current luminosity block
+void QWD0GlobalProducer::streamBeginLuminosityBlock(edm::StreamID iStream, const edm::LuminosityBlock&, const edm::EventSetup&) const {
+	QWD0Monitor & monitor = streamCache(iStream)->monitor();
+	std::lock_guard<std::mutex> guard(theMonitorCache->mutex);
+	theMonitorCache->monitor.merge(monitor);
+	monitor.clear();
+}
+
+// the framework serializes the calls for one summary
+void QWD0GlobalProducer::streamEndLuminosityBlockSummary(edm::StreamID iStream, const edm::LuminosityBlock&, const edm::EventSetup&, QWD0Cutflow* cutflow) const {
+	cutflow->mergeProduct(streamCache(iStream)->monitor());
+}
+
+std::shared_ptr<QWD0Cutflow> QWD0GlobalProducer::globalBeginLuminosityBlockSummary(const edm::LuminosityBlock&, const edm::EventSetup&) const {
+	return std::make_shared<QWD0Cutflow>();
+}
+
+void QWD0GlobalProducer::globalEndLuminosityBlockSummary(const edm::LuminosityBlock&, const edm::EventSetup&, QWD0Cutflow*) const {
+}
+
+void QWD0GlobalProducer::globalEndLuminosityBlockProduce(edm::LuminosityBlock& iLumi, const edm::EventSetup&, const QWD0Cutflow* cutflow) const {
+	if (!theMonitorCache->storeCutflow) return;
+	iLumi.put( std::auto_ptr<QWD0Cutflow>(new QWD0Cutflow(*cutflow)) );
+}
+
+void QWD0GlobalProducer::endStream(edm::StreamID iStream) const {
+	QWD0Monitor & monitor = streamCache(iStream)->monitor();
+	std::lock_guard<std::mutex> guard(theMonitorCache->mutex);
+	theMonitorCache->monitor.merge(monitor);
+	monitor.clear();
+}
+
+void QWD0GlobalProducer::endJob() {
+	theMonitorCache->monitor.report("QWD0GlobalProducer", theMonitorCache->moduleLabel, theMonitorCache->hypothesisLabels);
+}
+
+//define this as a plug-in
+#include "FWCore/PluginManager/interface/ModuleDef.h"
+
+DEFINE_FWK_MODULE(QWD0Producer);
+DEFINE_FWK_MODULE(QWD0GlobalProducer);
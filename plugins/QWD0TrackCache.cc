@@ -0,0 +1,151 @@
+#include "QWD0TrackCache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+const double QWD0TrackCache::curvatureScale = 1.25;
+const double QWD0TrackCache::turnPad = 0.05;
+const double QWD0TrackCache::dzPad = 0.1;
+
+void QWD0TrackCache::clear()
+{
+	refs.clear();
+	transientTracks.clear();
+	charge.clear();
+	positive.clear();
+	negative.clear();
+	valid.clear();
+	states.clear();
+	px.clear();
+	py.clear();
+	pz.clear();
+	pt.clear();
+	p2.clear();
+	phi.clear();
+	eta.clear();
+	d0.clear();
+	z0.clear();
+	curvature.clear();
+	turn.clear();
+	cosTurn.clear();
+	sinTurn.clear();
+	arcZ.clear();
+	ipSigXY.clear();
+	ipSigZ.clear();
+	zBeam.clear();
+	sigmaZBeam.clear();
+}
+
+void QWD0TrackCache::reserve(size_t n)
+{
+	refs.reserve(n);
+	transientTracks.reserve(n);
+	charge.reserve(n);
+	positive.reserve(n);
+	negative.reserve(n);
+	valid.reserve(n);
+	states.reserve(n);
+	px.reserve(n);
+	py.reserve(n);
+	pz.reserve(n);
+	pt.reserve(n);
+	p2.reserve(n);
+	phi.reserve(n);
+	eta.reserve(n);
+	d0.reserve(n);
+	z0.reserve(n);
+	curvature.reserve(n);
+	turn.reserve(n);
+	cosTurn.reserve(n);
+	sinTurn.reserve(n);
+	arcZ.reserve(n);
+	ipSigXY.reserve(n);
+	ipSigZ.reserve(n);
+	zBeam.reserve(n);
+	sigmaZBeam.reserve(n);
+}
+
+void QWD0TrackCache::push_back(const reco::TrackRef & ref, reco::TransientTrack && track, float sigXY, float sigZ, float z)
+{
+	if (ref->charge() > 0) positive.push_back(size());
+	if (ref->charge() < 0) negative.push_back(size());
+	refs.push_back(ref);
+	transientTracks.push_back(std::move(track));
+	charge.push_back(ref->charge() > 0 ? 1 : (ref->charge() < 0 ? -1 : 0));
+	ipSigXY.push_back(sigXY);
+	ipSigZ.push_back(sigZ);
+	zBeam.push_back(z);
+	sigmaZBeam.push_back(ref->dzError());
+
+	TrajectoryStateClosestToPoint const & tscp = transientTracks.back().impactPointTSCP();
+	valid.push_back(tscp.isValid());
+	if (!tscp.isValid()) {
+		states.push_back(FreeTrajectoryState());
+		px.push_back(0.);
+		py.push_back(0.);
+		pz.push_back(0.);
+		pt.push_back(0.);
+		p2.push_back(0.);
+		phi.push_back(0.);
+		eta.push_back(0.);
+		d0.push_back(0.);
+		z0.push_back(0.);
+		curvature.push_back(0.);
+		return;
+	}
+
+	GlobalVector momentum = tscp.momentum();
+	states.push_back(tscp.theState());
+	px.push_back(momentum.x());
+	py.push_back(momentum.y());
+	pz.push_back(momentum.z());
+	pt.push_back(momentum.perp());
+	p2.push_back(momentum.mag2());
+	phi.push_back(momentum.phi());
+	eta.push_back(momentum.eta());
+	d0.push_back(tscp.position().perp());
+	z0.push_back(tscp.position().z());
+	curvature.push_back(tscp.perigeeParameters().transverseCurvature());
+}
+
+void QWD0TrackCache::computeTurnBounds(double maxRadius)
+{
+	size_t n = size();
+	turn.assign(n, 0.);
+	cosTurn.assign(n, 1.);
+	sinTurn.assign(n, 0.);
+	arcZ.assign(n, 0.);
+
+	double maxD0 = 0.;
+	for (size_t trdx = 0; trdx < n; ++trdx) {
+		if (valid[trdx]) maxD0 = std::max(maxD0, double(d0[trdx]));
+	}
+
+	for (size_t trdx = 0; trdx < n; ++trdx) {
+		if (!valid[trdx]) continue;
+
+		double c = std::abs(curvature[trdx]);
+		double radius = c > 0. ? 1./(curvatureScale*c) : 0.;
+		// the crossing point is inside maxRadius, and for non-intersecting
+		// circles each track is at most half the gap between them away from it
+		double chord = maxRadius + 0.5*(d0[trdx] + maxD0) + d0[trdx];
+		double alpha, arc;
+		if (c == 0.) {
+			alpha = 0.;
+			arc = chord;
+		} else if (chord >= 2.*radius) {
+			alpha = M_PI;
+			arc = M_PI*radius;
+		} else {
+			alpha = 2.*std::asin(chord / (2.*radius));
+			arc = alpha*radius;
+		}
+		alpha = std::min(M_PI, alpha + turnPad);
+
+		turn[trdx] = alpha;
+		cosTurn[trdx] = std::cos(alpha);
+		sinTurn[trdx] = std::sin(alpha);
+		arcZ[trdx] = arc*std::abs(pz[trdx]/pt[trdx]) + dzPad;
+	}
+}
@@ -0,0 +1,73 @@
+#ifndef QWD0_TRACKCACHE_H
+#define QWD0_TRACKCACHE_H
+
+#include <vector>
+
+#include "DataFormats/TrackReco/interface/Track.h"
+#include "TrackingTools/TransientTrack/interface/TransientTrack.h"
+
+// Structure of arrays of the preselected tracks of one event, filled once
+// during the preselection. The pair loop, the pair finder and the pair
+// prefilter only read these arrays, indexed by the position of the track in
+// the preselection. The helix quantities are taken from impactPointTSCP, the
+// state at the PCA to the origin; they are 0 for tracks where it is not valid.
+struct dso_hidden QWD0TrackCache {
+	void clear();
+	void reserve(size_t n);
+	// the TransientTrack is moved in, reserve() the preselected tracks first
+	void push_back(const reco::TrackRef & ref, reco::TransientTrack && track, float ipSigXY, float ipSigZ, float zBeam);
+	// fill turn, cosTurn, sinTurn and arcZ once all tracks are in
+	void computeTurnBounds(double maxRadius);
+
+	// The margins of computeTurnBounds. The turn is computed for a field
+	// curvatureScale times the one at the PCA, above the largest |B| of the
+	// map inside maxRadius relative to the central field, then turnPad
+	// [rad] and dzPad [cm] are added for the non-uniform field and the
+	// float storage. A turn of pi allows any direction; the path is capped
+	// at pi R, which assumes the crossing point is within half a turn of the
+	// PCA. The binned and prefiltered pairs are checked against the
+	// brute-force loop with the tkDCA cut on in QWD0Regression_cfg.py.
+	static const double curvatureScale;
+	static const double turnPad;
+	static const double dzPad;
+	size_t size() const { return refs.size(); }
+
+	std::vector<reco::TrackRef> refs;
+	std::vector<reco::TransientTrack> transientTracks;
+	// -1, 0 or +1
+	std::vector<int> charge;
+	// indices of the positive and negative tracks, in increasing order
+	std::vector<unsigned> positive;
+	std::vector<unsigned> negative;
+	std::vector<bool> valid;
+	std::vector<FreeTrajectoryState> states;
+	// momentum at the PCA
+	std::vector<float> px;
+	std::vector<float> py;
+	std::vector<float> pz;
+	std::vector<float> pt;
+	// |p|^2, conserved along the helix
+	std::vector<float> p2;
+	std::vector<float> phi;
+	std::vector<float> eta;
+	// position of the PCA and signed transverse curvature [1/cm]
+	std::vector<float> d0;
+	std::vector<float> z0;
+	std::vector<float> curvature;
+	// upper bound on the angle the transverse momentum turns by, and on the
+	// |dz| travelled, between the PCA and any crossing point inside maxRadius.
+	// In a uniform field a helix turns by 2 asin(chord/2R); the bound is
+	// computed for a 25% stronger field and padded for the real field map.
+	std::vector<float> turn;
+	std::vector<float> cosTurn;
+	std::vector<float> sinTurn;
+	std::vector<float> arcZ;
+	// impact parameter significances used in the preselection
+	std::vector<float> ipSigXY;
+	std::vector<float> ipSigZ;
+	// z of the track at its PCA to the beam line, and its dzError
+	std::vector<float> zBeam;
+	std::vector<float> sigmaZBeam;
+};
+
+#endif
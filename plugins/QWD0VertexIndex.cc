@@ -0,0 +1,24 @@
+#include "QWD0VertexIndex.h"
+
+#include <algorithm>
+#include <cmath>
+
+void QWD0VertexIndex::build(const std::vector<reco::Vertex> & vertices)
+{
+	sorted_.clear();
+	for (unsigned ivtx = 0; ivtx < vertices.size(); ++ivtx) {
+		if (vertices[ivtx].isFake() || !vertices[ivtx].isValid()) continue;
+		sorted_.emplace_back(vertices[ivtx].z(), ivtx);
+	}
+	std::sort(sorted_.begin(), sorted_.end());
+}
+
+int QWD0VertexIndex::nearest(double z, double maxDz) const
+{
+	if (sorted_.empty()) return -1;
+	auto upper = std::lower_bound(sorted_.begin(), sorted_.end(), std::make_pair(z, -1));
+	auto best = upper;
+	if (upper == sorted_.end() || (upper != sorted_.begin() && z - (upper - 1)->first < upper->first - z)) best = upper - 1;
+	if (maxDz >= 0. && std::abs(best->first - z) > maxDz) return -1;
+	return best->second;
+}
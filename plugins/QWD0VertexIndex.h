@@ -0,0 +1,27 @@
+#ifndef QWD0_VERTEXINDEX_H
+#define QWD0_VERTEXINDEX_H
+
+#include <utility>
+#include <vector>
+
+#include "DataFormats/VertexReco/interface/Vertex.h"
+
+// The primary vertices of one event sorted by z, built once per event so
+// the vertex of a track or of a pair is found in O(log N_PV). Fake and
+// invalid vertices are left out.
+class dso_hidden QWD0VertexIndex {
+public:
+	void build(const std::vector<reco::Vertex> & vertices);
+	void clear() { sorted_.clear(); }
+	bool empty() const { return sorted_.empty(); }
+
+	// index into the collection of the vertex nearest in z, -1 if there is
+	// none within maxDz (maxDz < 0: any distance)
+	int nearest(double z, double maxDz) const;
+
+private:
+	// (z, index in the collection)
+	std::vector<std::pair<double, int>> sorted_;
+};
+
+#endif
@@ -0,0 +1,51 @@
+#include "QWD0ZWindow.h"
+
+#include <algorithm>
+#include <cmath>
+
+QWD0ZWindow::QWD0ZWindow() :
+	maxSignificance_(-1.),
+	sigmaMax_(0.)
+{
+}
+
+void QWD0ZWindow::build(const QWD0TrackCache & tracks)
+{
+	size_t n = tracks.size();
+	z_.assign(tracks.zBeam.begin(), tracks.zBeam.end());
+	sigma2_.resize(n);
+	sorted_.resize(n);
+	sigmaMax_ = 0.;
+	for (unsigned trdx = 0; trdx < n; ++trdx) {
+		sigma2_[trdx] = tracks.sigmaZBeam[trdx]*tracks.sigmaZBeam[trdx];
+		sigmaMax_ = std::max(sigmaMax_, double(tracks.sigmaZBeam[trdx]));
+		sorted_[trdx] = std::make_pair(tracks.zBeam[trdx], trdx);
+	}
+	std::sort(sorted_.begin(), sorted_.end());
+}
+
+void QWD0ZWindow::partners(unsigned trdx1, std::vector<unsigned> & out) const
+{
+	out.clear();
+	// no partner can be further away than with the largest error, padded
+	// so rounding never drops a pair compatible() accepts
+	float halfWidth = 1.001*maxSignificance_*std::sqrt(sigma2_[trdx1] + sigmaMax_*sigmaMax_);
+	auto begin = std::lower_bound(sorted_.begin(), sorted_.end(), std::make_pair(z_[trdx1] - halfWidth, 0u));
+	auto end = std::upper_bound(begin, sorted_.end(), std::make_pair(z_[trdx1] + halfWidth, ~0u));
+	for (auto it = begin; it != end; ++it) {
+		if (it->second > trdx1 && compatible(trdx1, it->second)) out.push_back(it->second);
+	}
+	std::sort(out.begin(), out.end());
+}
+
+void QWD0ZWindow::filter(unsigned trdx1, std::vector<unsigned> & partners) const
+{
+	partners.erase(std::remove_if(partners.begin(), partners.end(),
+			[this, trdx1](unsigned trdx2) { return !compatible(trdx1, trdx2); }), partners.end());
+}
+
+bool QWD0ZWindow::compatible(unsigned trdx1, unsigned trdx2) const
+{
+	float dz = z_[trdx1] - z_[trdx2];
+	return dz*dz <= maxSignificance_*maxSignificance_*(sigma2_[trdx1] + sigma2_[trdx2]);
+}
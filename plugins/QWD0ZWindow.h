@@ -0,0 +1,43 @@
+#ifndef QWD0_ZWINDOW_H
+#define QWD0_ZWINDOW_H
+
+#include <utility>
+#include <vector>
+
+#include "QWD0TrackCache.h"
+
+// Restricts the track pairs of QWD0Fitter::fitAll to tracks compatible in z
+// at the beam line, |z1 - z2| <= maxSignificance*sqrt(sigma1^2 + sigma2^2),
+// which removes most pairs of tracks from different pileup collisions before
+// any propagation. The tracks are sorted by z once per event, the partners
+// of a track are then found by binary search in the window its own error
+// and the largest error of the event allow, so an event costs O(N log N)
+// plus the pairs in the windows.
+class dso_hidden QWD0ZWindow {
+public:
+	QWD0ZWindow();
+
+	// < 0 disables the window
+	void setMaxSignificance(double maxSignificance) { maxSignificance_ = maxSignificance; }
+	bool enabled() const { return maxSignificance_ >= 0.; }
+
+	void build(const QWD0TrackCache & tracks);
+
+	// the sorted trdx2 > trdx1 inside the window of trdx1, safe to call concurrently
+	void partners(unsigned trdx1, std::vector<unsigned> & out) const;
+	// drop the partners outside the window of trdx1, keeps the order
+	void filter(unsigned trdx1, std::vector<unsigned> & partners) const;
+
+	bool compatible(unsigned trdx1, unsigned trdx2) const;
+
+private:
+	double maxSignificance_;
+	double sigmaMax_;
+	// indexed by trdx
+	std::vector<float> z_;
+	std::vector<float> sigma2_;
+	// (z, trdx) in increasing z
+	std::vector<std::pair<float, unsigned>> sorted_;
+};
+
+#endif
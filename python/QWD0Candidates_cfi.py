@@ -9,19 +9,92 @@ QWD0Candidates = cms.EDProducer("QWD0Producer",
    useVertex = cms.bool(True),
    # which vertex collection to use
    vertices = cms.InputTag('offlinePrimaryVertices'),
+   # which vertex: 'leading' (the first one), 'dz' (per track, and per pair
+   # the one nearest to the error weighted z of the daughters at the beam
+   # line) or 'pointing' (per track as 'dz', per pair the one nearest to where
+   # the flight line from the crossing point passes the beam line).
+   # Without vertices, or none within vertexAssociationMaxDz [cm] in 'dz' and
+   # 'pointing' (< 0 -> any), the beamSpot is used
+   vertexAssociation = cms.string('leading'),
+   vertexAssociationMaxDz = cms.double(1.),
 
    # which TrackCollection to use for vertexing
    trackRecoAlgorithm = cms.InputTag('generalTracks'),
 
    # which vertex fitting algorithm to use
-   # True -> KalmanVertexFitter (recommended)
-   # False -> AdaptiveVertexFitter (not recommended)
-   vertexFitter = cms.bool(True),
+   # 'kalman' -> KalmanVertexFitter (recommended)
+   # 'adaptive' -> AdaptiveVertexFitter (not recommended)
+   # 'analyticKalman', 'analyticAdaptive' -> the same, but only for pairs whose
+   #    analytic vertex estimate from the tracks at their crossing point passes
+   #    the vtxDecaySigXY and cosThetaXY cuts within analyticVertexMargin sigmas
+   # True/False as in older configurations -> 'kalman'/'adaptive'
+   vertexFitter = cms.string('kalman'),
+   analyticVertexMargin = cms.double(3.),
 
    # use the refitted tracks returned from the KVF for D0Candidate kinematics
    # this is automatically set to False if using the AdaptiveVertexFitter
    useRefTracks = cms.bool(True),
 
+   # how to form the track pairs that are vertexed
+   # 'bruteForce' -> every pair of preselected tracks
+   # 'binned' -> only pairs whose (phi, eta) bins can pass the same-quadrant
+   #             and DCA requirements inside the fiducial volume; the same
+   #             output within the margins of QWD0TrackCache: the curvature
+   #             scaled by 1.25 for the field map, 0.05 rad and 0.1 cm pads,
+   #             at most half a turn of each track before the vertex and the
+   #             vertex at most half the gap between non-crossing tracks away
+   #             from each. Kept off until test/QWD0Regression_cfg.py has run
+   #             on real data
+   pairFinder = cms.string('bruteForce'),
+   # which charge combinations are vertexed
+   # 'opposite' -> K-pi+ and K+pi- only (signal)
+   # 'same' -> same sign pairs only, tagged with pdgId +-81 (background)
+   # 'both' -> all pairs
+   chargeCombination = cms.string('both'),
+   # drop the pairs that can not pass the charge, same-quadrant, mPiPi and
+   # pre-fit D0 mass requirements in a vectorized batch before the closest
+   # approach; the same output within the margins of 'binned', whose turning
+   # bounds it uses, so off by default as well
+   pairPrefilter = cms.bool(False),
+   # 'auto' -> the best kernel the CPU supports, AVX-512, AVX2 or scalar
+   # 'scalar', 'avx2', 'avx512' -> that one, an error if the CPU lacks it
+   pairPrefilterKernel = cms.string('auto'),
+   # only pair tracks with |dz| < pairMaxDzSignificance*sqrt(sigma1^2 + sigma2^2)
+   # at the beam line, for pileup; < 0 -> no window
+   pairMaxDzSignificance = cms.double(-1.),
+   # fit the pairs of events with at least this many preselected tracks in
+   # parallel TBB tasks of parallelChunkSize first tracks each, 0 -> never;
+   # the output does not depend on the number of threads
+   parallelMinTracks = cms.uint32(0),
+   parallelChunkSize = cms.uint32(8),
+
+   # histogram the cut variables in the end-of-job summary
+   monitorHistograms = cms.untracked.bool(False),
+   # time the stages of the pair loop in the end-of-job summary
+   monitorTiming = cms.untracked.bool(False),
+   # put the time of each stage in the event as QWD0StageTimes, for
+   # monitoring modules; timing costs nothing while this and monitorTiming
+   # are False
+   storeStageTimes = cms.bool(False),
+   # put the per-lumi QWD0Cutflow into the LuminosityBlock
+   storeCutflow = cms.bool(False),
+   # put a QWD0FittedPairCollection with every pair passing the vertex cuts
+   # shared by all hypotheses (vertex, covariance, chi2 and the momenta at
+   # the vertex, by track key), for downstream modules to reuse the fits
+   storeFittedPairs = cms.bool(False),
+   # 'candidates': a VertexCompositeCandidateCollection per hypothesis,
+   # 'compact': a QWD0CompactCandidates per hypothesis instead, one row per
+   # pair with the masses of both assignments, the vertex once and the
+   # selection variables; QWD0CompactCandidates::expand gives the candidates,
+   # 'both': both products
+   outputFormat = cms.string('candidates'),
+   # with the candidates, put dca, mPiPi, decaySigXY, decaySigXYZ, cosThetaXY,
+   # cosThetaXYZ and swappedMass (the mass with the daughter masses swapped)
+   # as ValueMap<float>s keyed to them, instance labels
+   # 'dca' ... for the D0 and e.g. 'KshortDca' for the extraHypotheses;
+   # the compact format always has them as columns
+   storeVariables = cms.bool(False),
+
    # -- cuts on initial track collection --
    # Track normalized Chi2 <
    tkChi2Cut = cms.double(10.),
@@ -32,6 +105,26 @@ QWD0Candidates = cms.EDProducer("QWD0Producer",
    # Track impact parameter significance >
    tkIPSigXYCut = cms.double(2.),
    tkIPSigZCut = cms.double(-1.),
+   # tighter tkPtCut and tkIPSigXYCut from minTracks preselected tracks on,
+   # the step and the cuts used are put in the event as QWD0ThrottleInfo
+   multiplicitySteps = cms.VPSet(
+   #   cms.PSet(minTracks = cms.uint32(300), tkPtCut = cms.double(0.5), tkIPSigXYCut = cms.double(2.5)),
+   #   cms.PSet(minTracks = cms.uint32(600), tkPtCut = cms.double(0.7), tkIPSigXYCut = cms.double(3.)),
+   ),
+   # vertex fits per event, the pairs beyond are skipped and counted in
+   # QWD0ThrottleInfo, 0 -> no limit; only with parallelMinTracks = 0, as
+   # the pairs fitted would otherwise depend on the scheduling
+   maxVertexFits = cms.uint32(0),
+   # candidates of each hypothesis per event, the ones with the highest
+   # single precision vtxProb are kept with their ValueMaps; the compact
+   # rows keep the same candidates, a row counting one per assignment, and
+   # the fitted pairs are the ones of the candidates kept, 0 -> no limit
+   maxCandidates = cms.uint32(0),
+   # candidates of each hypothesis a track may be a daughter of per event,
+   # the ones with the highest vtxProb are kept; applied to the compact rows
+   # the same way, a row counting one per assignment, and the fitted pairs
+   # are the ones of the candidates kept, 0 -> no limit
+   maxCandidatesPerTrack = cms.uint32(0),
 
    # -- cuts on the vertex --
    # Vertex chi2 <
@@ -58,7 +151,60 @@ QWD0Candidates = cms.EDProducer("QWD0Producer",
 
    # -- cuts on the D0 candidate mass --
    # D0 mass window +- pdg value
-   D0MassCut = cms.double(0.2)
+   D0MassCut = cms.double(0.2),
+   # window added to D0MassCut, and to the massWindow of the extraHypotheses,
+   # for the masses from the momenta at the POCA, applied before the vertex fit
+   prefitD0MassTolerance = cms.double(0.1),
+   # when both mass assignments of a pair are in the window:
+   # 'both' -> a candidate for each
+   # 'closest' -> only the one closer to the mass
+   # 'single' -> as 'closest', with the other mass in the 'swappedMass'
+   #             ValueMap, stored even without storeVariables
+   massAssignment = cms.string('both'),
+
+   # -- switches for the optional cuts --
+   # they run at the cheapest point where their inputs exist:
+   # tkDCA, mPiPi and prefit D0 mass before the vertex fit,
+   # then vtxChi2, vtxProb, decay significances, innerHitPos and pointing
+   applyTkDCACut = cms.bool(False),
+   applyMPiPiCut = cms.bool(False),
+   applyPrefitD0MassCut = cms.bool(False),
+   applyVtxDecaySigXYCut = cms.bool(False),
+   applyVtxDecaySigXYZCut = cms.bool(False),
+   # needs the TrackExtra, keep False on AOD
+   applyInnerHitPosCut = cms.bool(False),
+   applyCosThetaXYZCut = cms.bool(False),
+
+   # -- further two-body hypotheses on the same fitted pairs --
+   # each fills its own collection, with the label as product instance name;
+   # the D0 above stays the unlabelled product. label, mass1, mass2, mass,
+   # massWindow and pdgId are required. sameSignPdgId (default 0: skip
+   # same-sign pairs), chargeConjugate (default True: the sign of the pdgId
+   # follows the mass1 daughter) and the decay significance and pointing cuts
+   # and switches are optional and default to the values above. The shared
+   # stages before the candidates apply the loosest cuts of all hypotheses.
+   extraHypotheses = cms.VPSet(
+   #   cms.PSet(
+   #      label = cms.string('Kshort'),
+   #      mass1 = cms.double(0.13957018),
+   #      mass2 = cms.double(0.13957018),
+   #      mass = cms.double(0.497614),
+   #      massWindow = cms.double(0.07),
+   #      pdgId = cms.int32(310),
+   #      chargeConjugate = cms.bool(False)
+   #   ),
+   #   cms.PSet(
+   #      label = cms.string('Lambda'),
+   #      mass1 = cms.double(0.938272046),
+   #      mass2 = cms.double(0.13957018),
+   #      mass = cms.double(1.115683),
+   #      massWindow = cms.double(0.05),
+   #      pdgId = cms.int32(3122)
+   #   ),
+   )
 
 )
 
+
+# the same configuration in an edm::global module, one fitter for all streams
+QWD0GlobalCandidates = cms.EDProducer("QWD0GlobalProducer", QWD0Candidates.parameters_())
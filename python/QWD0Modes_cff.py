@@ -0,0 +1,95 @@
+# The QWD0Producer configurations the test jobs time and compare, and the
+# input they share: the options, the conditions, the source and the
+# QWD0TrackMultiplier for more tracks per event.
+#
+# modes:
+#   bruteForce      - every pair, no prefilter, serial; the regression reference
+#   binned          - binned pairs, no prefilter, serial
+#   scalarPrefilter - binned pairs with the scalar pair prefilter, serial
+#   prefilter       - the same with the best pair prefilter kernel of the
+#                     CPU (AVX-512 or AVX2)
+#   parallel        - as prefilter, with the TBB pair loop in every event
+# all of them run the Kalman fit on every pair and give the same candidates.
+#   analytic        - parallel, skipping the fits the analytic vertex
+#                     rejects; loses a few candidates
+import FWCore.ParameterSet.Config as cms
+from FWCore.ParameterSet.VarParsing import VarParsing
+
+from QWAna.QWD0Producer.QWD0Candidates_cfi import QWD0Candidates
+
+def mode(name):
+	'''the QWD0Candidates settings of a mode'''
+	serial = cms.uint32(0)
+	modes = {
+		'bruteForce': dict(pairFinder = cms.string('bruteForce'), pairPrefilter = cms.bool(False),
+			vertexFitter = cms.string('kalman'), parallelMinTracks = serial),
+		'binned': dict(pairFinder = cms.string('binned'), pairPrefilter = cms.bool(False),
+			vertexFitter = cms.string('kalman'), parallelMinTracks = serial),
+		'scalarPrefilter': dict(pairFinder = cms.string('binned'), pairPrefilter = cms.bool(True),
+			pairPrefilterKernel = cms.string('scalar'), vertexFitter = cms.string('kalman'), parallelMinTracks = serial),
+		'prefilter': dict(pairFinder = cms.string('binned'), pairPrefilter = cms.bool(True),
+			vertexFitter = cms.string('kalman'), parallelMinTracks = serial),
+		'parallel': dict(pairFinder = cms.string('binned'), pairPrefilter = cms.bool(True),
+			vertexFitter = cms.string('kalman'), parallelMinTracks = cms.uint32(1)),
+		'analytic': dict(pairFinder = cms.string('binned'), pairPrefilter = cms.bool(True),
+			vertexFitter = cms.string('analyticKalman'), parallelMinTracks = cms.uint32(1)),
+	}
+	if name not in modes:
+		raise ValueError("unknown mode '%s', expected one of %s" % (name, ', '.join(sorted(modes))))
+	return modes[name]
+
+def registerOptions(options):
+	'''the options every test job takes, on a VarParsing('analysis')'''
+	options.register('copies', 1, VarParsing.multiplicity.singleton, VarParsing.varType.int,
+			"tracks per event are multiplied by this factor with QWD0TrackMultiplier")
+	options.register('tracks', 'generalTracks', VarParsing.multiplicity.singleton, VarParsing.varType.string,
+			"input track collection")
+	options.register('globalTag', 'auto:run2_data', VarParsing.multiplicity.singleton, VarParsing.varType.string,
+			"global tag for the magnetic field")
+	options.register('threads', 1, VarParsing.multiplicity.singleton, VarParsing.varType.int,
+			"number of threads")
+
+def configure(process, options, streams = 0, reportEvery = 100):
+	'''the services, conditions and source of a test job, and process.p with
+	the QWD0TrackMultiplier when copies > 1'''
+	process.load("FWCore.MessageService.MessageLogger_cfi")
+	process.MessageLogger.cerr.FwkReport.reportEvery = reportEvery
+	process.load("Configuration.StandardSequences.MagneticField_cff")
+	process.load("Configuration.StandardSequences.FrontierConditions_GlobalTag_condDBv2_cff")
+	from Configuration.AlCa.GlobalTag import GlobalTag
+	process.GlobalTag = GlobalTag(process.GlobalTag, options.globalTag, '')
+
+	process.source = cms.Source("PoolSource",
+			fileNames = cms.untracked.vstring(options.inputFiles)
+			)
+	process.maxEvents = cms.untracked.PSet(input = cms.untracked.int32(options.maxEvents))
+	process.options = cms.untracked.PSet(
+			numberOfThreads = cms.untracked.uint32(options.threads),
+			numberOfStreams = cms.untracked.uint32(streams)
+			)
+
+	process.p = cms.Path()
+	if options.copies > 1:
+		process.QWD0Tracks = cms.EDProducer("QWD0TrackMultiplier",
+				src = cms.InputTag(options.tracks),
+				beamSpot = cms.InputTag('offlineBeamSpot'),
+				copies = cms.uint32(options.copies)
+				)
+		process.p += process.QWD0Tracks
+
+def tracks(options):
+	'''the tracks the candidates are built from'''
+	return cms.InputTag('QWD0Tracks' if options.copies > 1 else options.tracks)
+
+def candidates(options, name, **changes):
+	'''QWD0Candidates in mode name on the tracks of the job'''
+	settings = dict(
+			trackRecoAlgorithm = tracks(options),
+			applyInnerHitPosCut = cms.bool(False),
+			# the copies have no hit pattern; left out with and without them,
+			# so every number of copies selects the tracks the same way
+			tkNHitsCut = cms.int32(0)
+			)
+	settings.update(mode(name))
+	settings.update(changes)
+	return QWD0Candidates.clone(**settings)
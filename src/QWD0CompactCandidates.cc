@@ -0,0 +1,170 @@
+#include "QWAna/QWD0Producer/interface/QWD0CompactCandidates.h"
+
+#include <cmath>
+
+#include "DataFormats/TrackReco/interface/Track.h"
+#include "DataFormats/Candidate/interface/VertexCompositeCandidate.h"
+#include "DataFormats/RecoCandidate/interface/RecoChargedCandidate.h"
+
+QWD0CompactCandidates::QWD0CompactCandidates() :
+	mass1_(0.),
+	mass2_(0.),
+	pdgId_(0),
+	sameSignPdgId_(0),
+	chargeConjugate_(false)
+{
+}
+
+void QWD0CompactCandidates::setHypothesis(double mass1, double mass2, int pdgId, int sameSignPdgId, bool chargeConjugate)
+{
+	mass1_ = mass1;
+	mass2_ = mass2;
+	pdgId_ = pdgId;
+	sameSignPdgId_ = sameSignPdgId;
+	chargeConjugate_ = chargeConjugate;
+}
+
+void QWD0CompactCandidates::reserve(size_t n)
+{
+	pairs_.reserve(n);
+	charge1_.reserve(n);
+	charge2_.reserve(n);
+	assignments_.reserve(n);
+	mass12_.reserve(n);
+	mass21_.reserve(n);
+	dca_.reserve(n);
+	mPiPi_.reserve(n);
+	decaySigXY_.reserve(n);
+	decaySigXYZ_.reserve(n);
+	cosThetaXY_.reserve(n);
+	cosThetaXYZ_.reserve(n);
+}
+
+void QWD0CompactCandidates::clear()
+{
+	pairs_.clear();
+	charge1_.clear();
+	charge2_.clear();
+	assignments_.clear();
+	mass12_.clear();
+	mass21_.clear();
+	dca_.clear();
+	mPiPi_.clear();
+	decaySigXY_.clear();
+	decaySigXYZ_.clear();
+	cosThetaXY_.clear();
+	cosThetaXYZ_.clear();
+}
+
+void QWD0CompactCandidates::push_back(const QWD0FittedPair & pair, int charge1, int charge2, unsigned assignments,
+		double mass12, double mass21, double dca, double mPiPi,
+		double decaySigXY, double decaySigXYZ, double cosThetaXY, double cosThetaXYZ)
+{
+	pairs_.push_back(pair);
+	charge1_.push_back(charge1);
+	charge2_.push_back(charge2);
+	assignments_.push_back(assignments);
+	mass12_.push_back(mass12);
+	mass21_.push_back(mass21);
+	dca_.push_back(dca);
+	mPiPi_.push_back(mPiPi);
+	decaySigXY_.push_back(decaySigXY);
+	decaySigXYZ_.push_back(decaySigXYZ);
+	cosThetaXY_.push_back(cosThetaXY);
+	cosThetaXYZ_.push_back(cosThetaXYZ);
+}
+
+namespace {
+	template <class T>
+	void moveColumn(std::vector<T> & to, std::vector<T> & from) {
+		to.insert(to.end(), from.begin(), from.end());
+		from.clear();
+	}
+
+	// rows[i] >= i, the sources are not written over before they move
+	template <class T>
+	void keepColumn(std::vector<T> & column, const std::vector<unsigned> & rows) {
+		for (unsigned i = 0; i < rows.size(); ++i) column[i] = column[rows[i]];
+		column.resize(rows.size());
+	}
+}
+
+void QWD0CompactCandidates::append(QWD0CompactCandidates & other)
+{
+	moveColumn(pairs_, other.pairs_);
+	moveColumn(charge1_, other.charge1_);
+	moveColumn(charge2_, other.charge2_);
+	moveColumn(assignments_, other.assignments_);
+	moveColumn(mass12_, other.mass12_);
+	moveColumn(mass21_, other.mass21_);
+	moveColumn(dca_, other.dca_);
+	moveColumn(mPiPi_, other.mPiPi_);
+	moveColumn(decaySigXY_, other.decaySigXY_);
+	moveColumn(decaySigXYZ_, other.decaySigXYZ_);
+	moveColumn(cosThetaXY_, other.cosThetaXY_);
+	moveColumn(cosThetaXYZ_, other.cosThetaXYZ_);
+}
+
+void QWD0CompactCandidates::keepOnly(const std::vector<unsigned> & rows)
+{
+	keepColumn(pairs_, rows);
+	keepColumn(charge1_, rows);
+	keepColumn(charge2_, rows);
+	keepColumn(assignments_, rows);
+	keepColumn(mass12_, rows);
+	keepColumn(mass21_, rows);
+	keepColumn(dca_, rows);
+	keepColumn(mPiPi_, rows);
+	keepColumn(decaySigXY_, rows);
+	keepColumn(decaySigXYZ_, rows);
+	keepColumn(cosThetaXY_, rows);
+	keepColumn(cosThetaXYZ_, rows);
+}
+
+void QWD0CompactCandidates::keepCandidates(const std::vector<unsigned> & counts)
+{
+	std::vector<unsigned> rows;
+	for (unsigned i = 0; i < size(); ++i) {
+		if (counts[i] == 0) continue;
+		if (counts[i] == 1 && (assignments_[i] & kFirstIsMass1)) assignments_[i] &= ~kSecondIsMass1;
+		rows.push_back(i);
+	}
+	if (rows.size() < size()) keepOnly(rows);
+}
+
+void QWD0CompactCandidates::expand(size_t i, const edm::Handle<reco::TrackCollection> & tracks,
+		reco::VertexCompositeCandidateCollection & out) const
+{
+	const QWD0FittedPair & pair = pairs_[i];
+	int charge1 = charge1_[i];
+	int charge2 = charge2_[i];
+	int pdgId = charge1 == charge2 ? sameSignPdgId_ : pdgId_;
+	reco::Particle::Point vtx(pair.position());
+	const QWD0FittedPair::CovarianceMatrix vtxCov(pair.covariance());
+	QWD0FittedPair::Vector P1 = pair.momentum1();
+	QWD0FittedPair::Vector P2 = pair.momentum2();
+
+	for (unsigned iassign = 0; iassign < 2; ++iassign) {
+		if (!(assignments_[i] & (iassign ? kSecondIsMass1 : kFirstIsMass1))) continue;
+		double m1 = iassign ? mass2_ : mass1_;
+		double m2 = iassign ? mass1_ : mass2_;
+
+		reco::RecoChargedCandidate theCand1(charge1, reco::Particle::LorentzVector(P1.x(), P1.y(), P1.z(), sqrt(P1.Mag2() + m1*m1)), vtx);
+		theCand1.setTrack(reco::TrackRef(tracks, pair.key1()));
+		reco::RecoChargedCandidate theCand2(charge2, reco::Particle::LorentzVector(P2.x(), P2.y(), P2.z(), sqrt(P2.Mag2() + m2*m2)), vtx);
+		theCand2.setTrack(reco::TrackRef(tracks, pair.key2()));
+
+		int mass1Charge = iassign ? charge2 : charge1;
+		out.emplace_back(charge1 + charge2, theCand1.p4() + theCand2.p4(), vtx, vtxCov, pair.chi2(), pair.ndof());
+		reco::VertexCompositeCandidate & theCand = out.back();
+		theCand.addDaughter(theCand1);
+		theCand.addDaughter(theCand2);
+		theCand.setPdgId(chargeConjugate_ && mass1Charge < 0 ? -pdgId : pdgId);
+	}
+}
+
+void QWD0CompactCandidates::expand(const edm::Handle<reco::TrackCollection> & tracks,
+		reco::VertexCompositeCandidateCollection & out) const
+{
+	for (size_t i = 0; i < size(); ++i) expand(i, tracks, out);
+}
@@ -0,0 +1,92 @@
+#include "QWAna/QWD0Producer/interface/QWD0Cutflow.h"
+
+QWD0Cutflow::QWD0Cutflow() :
+	nEvents_(0),
+	nTracks_(0),
+	nSelected_(0),
+	nPairs_(0),
+	nCandidates_(0),
+	rejected_(nCuts, 0),
+	stageNanoseconds_(nStages, 0),
+	stageCalls_(nStages, 0)
+{
+}
+
+unsigned long long QWD0Cutflow::remaining(Cut cut) const
+{
+	unsigned long long n = nPairs_;
+	for (unsigned icut = 0; icut <= unsigned(cut) && icut < rejected_.size(); ++icut) {
+		n -= rejected_[icut] < n ? rejected_[icut] : n;
+	}
+	return n;
+}
+
+void QWD0Cutflow::clear()
+{
+	nEvents_ = nTracks_ = nSelected_ = nPairs_ = nCandidates_ = 0;
+	rejected_.assign(nCuts, 0);
+	stageNanoseconds_.assign(nStages, 0);
+	stageCalls_.assign(nStages, 0);
+}
+
+bool QWD0Cutflow::mergeProduct(const QWD0Cutflow & other)
+{
+	if (other.rejected_.size() != rejected_.size() || other.stageCalls_.size() != stageCalls_.size()) return false;
+
+	nEvents_ += other.nEvents_;
+	nTracks_ += other.nTracks_;
+	nSelected_ += other.nSelected_;
+	nPairs_ += other.nPairs_;
+	nCandidates_ += other.nCandidates_;
+	for (unsigned icut = 0; icut < rejected_.size(); ++icut) rejected_[icut] += other.rejected_[icut];
+	for (unsigned istage = 0; istage < stageCalls_.size(); ++istage) {
+		stageNanoseconds_[istage] += other.stageNanoseconds_[istage];
+		stageCalls_[istage] += other.stageCalls_[istage];
+	}
+	return true;
+}
+
+const char * QWD0Cutflow::cutName(Cut cut)
+{
+	switch (cut) {
+		case kPrefilter: return "prefilter";
+		case kCharge: return "charge";
+		case kImpactPointTSCP: return "impactPointTSCP";
+		case kClosestApproach: return "closestApproach";
+		case kDCA: return "tkDCA";
+		case kFiducial: return "fiducial";
+		case kCrossingTSCP: return "crossingTSCP";
+		case kQuadrant: return "quadrant";
+		case kMPiPi: return "mPiPi";
+		case kPrefitD0Mass: return "prefitD0Mass";
+		case kAnalyticVertex: return "analyticVertex";
+		case kFitBudget: return "fitBudget";
+		case kVertexFit: return "vertexFit";
+		case kVtxChi2: return "vtxChi2";
+		case kVtxProb: return "vtxProb";
+		case kDecaySigXY: return "vtxDecaySigXY";
+		case kDecaySigXYZ: return "vtxDecaySigXYZ";
+		case kInnerHitPos: return "innerHitPos";
+		case kVertexTSCP: return "vertexTSCP";
+		case kCosThetaXY: return "cosThetaXY";
+		case kCosThetaXYZ: return "cosThetaXYZ";
+		case kD0Mass: return "D0Mass";
+		default: return "unknown";
+	}
+}
+
+const char * QWD0Cutflow::stageName(Stage stage)
+{
+	switch (stage) {
+		case kPreselectionStage: return "preselection";
+		case kPairingStage: return "pairing";
+		case kPrefilterStage: return "prefilter";
+		case kClosestApproachStage: return "closestApproach";
+		case kCrossingTSCPStage: return "crossingTSCP";
+		case kAnalyticVertexStage: return "analyticVertex";
+		case kVertexFitStage: return "vertexFit";
+		case kVertexTSCPStage: return "vertexTSCP";
+		case kCandidateStage: return "candidates";
+		default: return "unknown";
+	}
+}
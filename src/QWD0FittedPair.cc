@@ -0,0 +1,37 @@
+#include "QWAna/QWD0Producer/interface/QWD0FittedPair.h"
+
+QWD0FittedPair::QWD0FittedPair() :
+	key1_(0),
+	key2_(0),
+	position_{0., 0., 0.},
+	covariance_{0., 0., 0., 0., 0., 0.},
+	chi2_(0.),
+	ndof_(0.),
+	momentum1_{0., 0., 0.},
+	momentum2_{0., 0., 0.}
+{
+}
+
+QWD0FittedPair::QWD0FittedPair(unsigned key1, unsigned key2, const Point & position, const CovarianceMatrix & covariance,
+		double chi2, double ndof, const Vector & momentum1, const Vector & momentum2) :
+	key1_(key1),
+	key2_(key2),
+	position_{float(position.x()), float(position.y()), float(position.z())},
+	chi2_(chi2),
+	ndof_(ndof),
+	momentum1_{float(momentum1.x()), float(momentum1.y()), float(momentum1.z())},
+	momentum2_{float(momentum2.x()), float(momentum2.y()), float(momentum2.z())}
+{
+	for (int i = 0; i < 3; ++i) {
+		for (int j = i; j < 3; ++j) covariance_[index(i, j)] = covariance(i, j);
+	}
+}
+
+QWD0FittedPair::CovarianceMatrix QWD0FittedPair::covariance() const
+{
+	CovarianceMatrix cov;
+	for (int i = 0; i < 3; ++i) {
+		for (int j = i; j < 3; ++j) cov(i, j) = covariance_[index(i, j)];
+	}
+	return cov;
+}
@@ -0,0 +1,22 @@
+#include "DataFormats/Common/interface/Wrapper.h"
+#include "QWAna/QWD0Producer/interface/QWD0Cutflow.h"
+#include "QWAna/QWD0Producer/interface/QWD0FittedPair.h"
+#include "QWAna/QWD0Producer/interface/QWD0CompactCandidates.h"
+#include "QWAna/QWD0Producer/interface/QWD0ThrottleInfo.h"
+#include "QWAna/QWD0Producer/interface/QWD0StageTimes.h"
+
+namespace QWAna_QWD0Producer {
+	struct dictionary {
+		QWD0Cutflow cutflow;
+		edm::Wrapper<QWD0Cutflow> wcutflow;
+		QWD0FittedPair fittedPair;
+		QWD0FittedPairCollection fittedPairs;
+		edm::Wrapper<QWD0FittedPairCollection> wfittedPairs;
+		QWD0CompactCandidates compactCandidates;
+		edm::Wrapper<QWD0CompactCandidates> wcompactCandidates;
+		QWD0ThrottleInfo throttleInfo;
+		edm::Wrapper<QWD0ThrottleInfo> wthrottleInfo;
+		QWD0StageTimes stageTimes;
+		edm::Wrapper<QWD0StageTimes> wstageTimes;
+	};
+}
@@ -0,0 +1,45 @@
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+
+// Test-only allocation counter for the QWD0Producer benchmarks, preloaded
+// into a cmsRun that uses the allocator of glibc:
+//   LD_PRELOAD=$CMSSW_BASE/lib/$SCRAM_ARCH/libQWD0AllocationCounter.so cmsRunGlibC QWD0Benchmark_cfg.py countAllocations=1 ...
+// counts every malloc, calloc, realloc and aligned allocation of the job,
+// operator new included, and hands them on to glibc. QWD0AllocationRecorder
+// reads the count through qwd0AllocationCount().
+
+extern "C" {
+	void * __libc_malloc(size_t);
+	void * __libc_calloc(size_t, size_t);
+	void * __libc_realloc(void *, size_t);
+	void * __libc_memalign(size_t, size_t);
+	void __libc_free(void *);
+}
+
+namespace {
+	std::atomic<unsigned long long> nAllocations(0);
+
+	void count() { nAllocations.fetch_add(1, std::memory_order_relaxed); }
+}
+
+extern "C" {
+	unsigned long long qwd0AllocationCount() { return nAllocations.load(std::memory_order_relaxed); }
+
+	void * malloc(size_t size) noexcept { count(); return __libc_malloc(size); }
+	void * calloc(size_t n, size_t size) noexcept { count(); return __libc_calloc(n, size); }
+	void * realloc(void * ptr, size_t size) noexcept { count(); return __libc_realloc(ptr, size); }
+	void * memalign(size_t alignment, size_t size) noexcept { count(); return __libc_memalign(alignment, size); }
+	void * aligned_alloc(size_t alignment, size_t size) noexcept { count(); return __libc_memalign(alignment, size); }
+	int posix_memalign(void ** ptr, size_t alignment, size_t size) noexcept {
+		if (alignment < sizeof(void *) || (alignment & (alignment - 1)) != 0) return EINVAL;
+		count();
+		void * p = __libc_memalign(alignment, size);
+		if (p == nullptr && size != 0) return ENOMEM;
+		*ptr = p;
+		return 0;
+	}
+	// so memory from a preloaded malloc is never freed by another allocator
+	void free(void * ptr) noexcept { __libc_free(ptr); }
+}
@@ -0,0 +1,71 @@
+#include <algorithm>
+#include <string>
+
+#include "FWCore/Framework/interface/Frameworkfwd.h"
+#include "FWCore/Framework/interface/one/EDAnalyzer.h"
+#include "FWCore/Framework/interface/Event.h"
+#include "FWCore/Framework/interface/MakerMacros.h"
+#include "FWCore/ParameterSet/interface/ParameterSet.h"
+#include "FWCore/MessageLogger/interface/MessageLogger.h"
+
+// from libQWD0AllocationCounter.so when it is preloaded, null otherwise
+extern "C" unsigned long long qwd0AllocationCount() __attribute__((weak));
+
+// Allocations per event of the module in front of it on the path: reads the
+// count of QWD0AllocationCounter and takes the difference to the recorder
+// that ran before it in the event, so a path of
+//   recorder '', module A, recorder 'A', module B, recorder 'B'
+// reports the allocations of A and of B, the one with the empty label only
+// starts the count. Only meaningful with one thread; prints the mean and
+// the largest count per event at the end of the job.
+class dso_hidden QWD0AllocationRecorder final : public edm::one::EDAnalyzer<> {
+public:
+	explicit QWD0AllocationRecorder(const edm::ParameterSet&);
+
+private:
+	void analyze(const edm::Event&, const edm::EventSetup&) override;
+	void endJob() override;
+
+	std::string label_;
+	unsigned long long nEvents_;
+	unsigned long long total_;
+	unsigned long long max_;
+};
+
+namespace {
+	// the count when the last recorder ran, shared by all of them
+	unsigned long long lastCount = 0;
+}
+
+QWD0AllocationRecorder::QWD0AllocationRecorder(const edm::ParameterSet& iConfig) :
+	label_(iConfig.getParameter<std::string>("label")),
+	nEvents_(0),
+	total_(0),
+	max_(0)
+{
+	if (!qwd0AllocationCount) {
+		edm::LogWarning("QWD0AllocationRecorder") << "libQWD0AllocationCounter.so is not preloaded, no allocations are counted";
+	}
+}
+
+void QWD0AllocationRecorder::analyze(const edm::Event&, const edm::EventSetup&)
+{
+	if (!qwd0AllocationCount) return;
+	unsigned long long count = qwd0AllocationCount();
+	unsigned long long n = count - lastCount;
+	lastCount = count;
+	// the first recorder in the event only starts the count
+	if (label_.empty()) return;
+	++nEvents_;
+	total_ += n;
+	max_ = std::max(max_, n);
+}
+
+void QWD0AllocationRecorder::endJob()
+{
+	if (label_.empty() || !qwd0AllocationCount) return;
+	edm::LogVerbatim("QWD0AllocationRecorder") << label_ << ": " << nEvents_ << " events, "
+		<< (nEvents_ ? double(total_)/nEvents_ : 0.) << " allocations per event, at most " << max_;
+}
+
+DEFINE_FWK_MODULE(QWD0AllocationRecorder);
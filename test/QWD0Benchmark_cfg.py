@@ -0,0 +1,63 @@
+# Benchmark of the QWD0Fitter stages: runs the binned and the parallel
+# pair loop side by side on the same events and prints, for each, the cutflow,
+# the time per stage (preselection, pairing, prefilter, closestApproach,
+# vertexFit, candidate, ...), the time per event and the pairs per second.
+# The Timing service adds the per-module time, SimpleMemoryCheck the events
+# where the RSS and VSIZE of the job grew. countAllocations=1 puts a
+# QWD0AllocationRecorder behind every mode for the allocations per event,
+# with the test counter preloaded and one thread:
+#   LD_PRELOAD=$CMSSW_BASE/lib/$SCRAM_ARCH/libQWD0AllocationCounter.so cmsRunGlibC QWD0Benchmark_cfg.py inputFiles=file:tracks.root countAllocations=1
+#
+# make a small input with only the tracks, beamspot and vertices once:
+#   cmsRun QWD0Benchmark_cfg.py inputFiles=file:AOD.root skim=1 outputFile=tracks.root
+# then time it, scaling the number of tracks per event by copies:
+#   cmsRun QWD0Benchmark_cfg.py inputFiles=file:tracks_numEvent100.root copies=3
+#   cmsRun QWD0Benchmark_cfg.py inputFiles=file:tracks.root modes=bruteForce,parallel
+#
+# the modes are the ones of python/QWD0Modes_cff.py
+import FWCore.ParameterSet.Config as cms
+from FWCore.ParameterSet.VarParsing import VarParsing
+from QWAna.QWD0Producer.QWD0Modes_cff import registerOptions, configure, candidates
+
+options = VarParsing('analysis')
+registerOptions(options)
+options.register('skim', 0, VarParsing.multiplicity.singleton, VarParsing.varType.int,
+		"only write the tracks, beamspot and vertices of the input to outputFile")
+options.register('modes', 'binned,parallel', VarParsing.multiplicity.singleton, VarParsing.varType.string,
+		"comma separated configurations to time")
+options.register('countAllocations', 0, VarParsing.multiplicity.singleton, VarParsing.varType.int,
+		"report the allocations per event of every mode, needs libQWD0AllocationCounter.so preloaded")
+options.parseArguments()
+
+process = cms.Process("QWD0Benchmark")
+configure(process, options)
+process.options.wantSummary = cms.untracked.bool(True)
+
+if options.skim:
+	process.out = cms.OutputModule("PoolOutputModule",
+			fileName = cms.untracked.string(options.outputFile),
+			outputCommands = cms.untracked.vstring(
+				'drop *',
+				'keep recoTracks_' + options.tracks + '_*_*',
+				'keep recoBeamSpot_offlineBeamSpot_*_*',
+				'keep recoVertexs_offlinePrimaryVertices_*_*'
+				)
+			)
+	process.e = cms.EndPath(process.out)
+else:
+	process.Timing = cms.Service("Timing", summaryOnly = cms.untracked.bool(True))
+	process.SimpleMemoryCheck = cms.Service("SimpleMemoryCheck", ignoreTotal = cms.untracked.int32(1))
+
+	if options.countAllocations:
+		if options.threads != 1:
+			raise ValueError("countAllocations needs threads=1, the count is for the whole job")
+		process.QWD0Allocations = cms.EDAnalyzer("QWD0AllocationRecorder", label = cms.string(''))
+		process.p += process.QWD0Allocations
+	for mode in options.modes.split(','):
+		module = candidates(options, mode, monitorTiming = cms.untracked.bool(True))
+		setattr(process, 'QWD0' + mode, module)
+		process.p += module
+		if options.countAllocations:
+			recorder = cms.EDAnalyzer("QWD0AllocationRecorder", label = cms.string(mode))
+			setattr(process, 'QWD0' + mode + 'Allocations', recorder)
+			process.p += recorder
@@ -0,0 +1,185 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <tuple>
+#include <vector>
+
+#include "FWCore/Framework/interface/Frameworkfwd.h"
+#include "FWCore/Framework/interface/global/EDAnalyzer.h"
+#include "FWCore/Framework/interface/Event.h"
+#include "FWCore/Framework/interface/MakerMacros.h"
+#include "FWCore/ParameterSet/interface/ParameterSet.h"
+#include "FWCore/MessageLogger/interface/MessageLogger.h"
+#include "FWCore/Utilities/interface/Exception.h"
+#include "FWCore/Utilities/interface/InputTag.h"
+#include "DataFormats/Candidate/interface/VertexCompositeCandidate.h"
+#include "DataFormats/TrackReco/interface/Track.h"
+#include "QWAna/QWD0Producer/interface/QWD0CompactCandidates.h"
+
+// Regression check of the QWD0Producer fast paths: compares the candidates
+// of a test configuration with those of the reference loop on the same
+// events. Candidates are matched by the keys of their daughter tracks and
+// their pdgId, then their mass and vertex have to agree within the
+// tolerances, an absolute one plus a relative one times the momentum and
+// the distance of the vertex from the origin of the reference candidate. Every lost, gained or changed candidate is logged, the totals
+// are printed at the end of the job, which fails if failOnDifference is set
+// and anything differs. With testFormat 'compact' the test is a
+// QWD0CompactCandidates, whose expand() on the tracks is compared.
+class dso_hidden QWD0CandidateComparator final : public edm::global::EDAnalyzer<> {
+public:
+	explicit QWD0CandidateComparator(const edm::ParameterSet&);
+
+private:
+	struct Entry {
+		unsigned key1;
+		unsigned key2;
+		int pdgId;
+		const reco::VertexCompositeCandidate * cand;
+		bool operator<(const Entry & other) const {
+			return std::tie(key1, key2, pdgId) < std::tie(other.key1, other.key2, other.pdgId);
+		}
+	};
+
+	void analyze(edm::StreamID, const edm::Event&, const edm::EventSetup&) const override;
+	void endJob() override;
+
+	static std::vector<Entry> entries(const reco::VertexCompositeCandidateCollection & cands);
+	void log(const char * what, const edm::Event & iEvent, const Entry & entry) const;
+
+	edm::EDGetTokenT<reco::VertexCompositeCandidateCollection> token_reference;
+	edm::EDGetTokenT<reco::VertexCompositeCandidateCollection> token_test;
+	bool compact_;
+	edm::EDGetTokenT<QWD0CompactCandidates> token_testCompact;
+	edm::EDGetTokenT<reco::TrackCollection> token_tracks;
+	std::string testLabel_;
+	double massTolerance_;
+	double vertexTolerance_;
+	double relativeMassTolerance_;
+	double relativeVertexTolerance_;
+	bool failOnDifference_;
+
+	mutable std::atomic<unsigned long long> nEvents_;
+	mutable std::atomic<unsigned long long> nMatched_;
+	mutable std::atomic<unsigned long long> nLost_;
+	mutable std::atomic<unsigned long long> nGained_;
+	mutable std::atomic<unsigned long long> nChanged_;
+};
+
+QWD0CandidateComparator::QWD0CandidateComparator(const edm::ParameterSet& iConfig) :
+	token_reference(consumes<reco::VertexCompositeCandidateCollection>(iConfig.getParameter<edm::InputTag>("reference"))),
+	compact_(iConfig.getParameter<std::string>("testFormat") == "compact"),
+	testLabel_(iConfig.getParameter<edm::InputTag>("test").encode()),
+	massTolerance_(iConfig.getParameter<double>("massTolerance")),
+	vertexTolerance_(iConfig.getParameter<double>("vertexTolerance")),
+	relativeMassTolerance_(iConfig.getParameter<double>("relativeMassTolerance")),
+	relativeVertexTolerance_(iConfig.getParameter<double>("relativeVertexTolerance")),
+	failOnDifference_(iConfig.getParameter<bool>("failOnDifference")),
+	nEvents_(0),
+	nMatched_(0),
+	nLost_(0),
+	nGained_(0),
+	nChanged_(0)
+{
+	std::string testFormat = iConfig.getParameter<std::string>("testFormat");
+	if (compact_) {
+		token_testCompact = consumes<QWD0CompactCandidates>(iConfig.getParameter<edm::InputTag>("test"));
+		token_tracks = consumes<reco::TrackCollection>(iConfig.getParameter<edm::InputTag>("tracks"));
+	} else if (testFormat == "candidates") {
+		token_test = consumes<reco::VertexCompositeCandidateCollection>(iConfig.getParameter<edm::InputTag>("test"));
+	} else {
+		throw cms::Exception("Configuration") << "QWD0CandidateComparator: unknown testFormat '" << testFormat << "', use 'candidates' or 'compact'";
+	}
+}
+
+std::vector<QWD0CandidateComparator::Entry> QWD0CandidateComparator::entries(const reco::VertexCompositeCandidateCollection & cands)
+{
+	std::vector<Entry> out;
+	out.reserve(cands.size());
+	for (const reco::VertexCompositeCandidate & cand : cands) {
+		Entry entry;
+		entry.key1 = cand.daughter(0)->get<reco::TrackRef>().key();
+		entry.key2 = cand.daughter(1)->get<reco::TrackRef>().key();
+		entry.pdgId = cand.pdgId();
+		entry.cand = &cand;
+		out.push_back(entry);
+	}
+	std::stable_sort(out.begin(), out.end());
+	return out;
+}
+
+void QWD0CandidateComparator::log(const char * what, const edm::Event & iEvent, const Entry & entry) const
+{
+	edm::LogWarning("QWD0CandidateComparator") << testLabel_ << ": " << what << " candidate in run " << iEvent.id().run()
+		<< " event " << iEvent.id().event() << ": tracks " << entry.key1 << " " << entry.key2 << " pdgId " << entry.pdgId
+		<< " mass " << entry.cand->mass() << " vertex (" << entry.cand->vx() << ", " << entry.cand->vy() << ", " << entry.cand->vz() << ")";
+}
+
+void QWD0CandidateComparator::analyze(edm::StreamID, const edm::Event& iEvent, const edm::EventSetup&) const
+{
+	edm::Handle<reco::VertexCompositeCandidateCollection> reference;
+	iEvent.getByToken(token_reference, reference);
+	reco::VertexCompositeCandidateCollection expanded;
+	const reco::VertexCompositeCandidateCollection * test = &expanded;
+	if (compact_) {
+		edm::Handle<QWD0CompactCandidates> compact;
+		iEvent.getByToken(token_testCompact, compact);
+		edm::Handle<reco::TrackCollection> tracks;
+		iEvent.getByToken(token_tracks, tracks);
+		compact->expand(tracks, expanded);
+	} else {
+		edm::Handle<reco::VertexCompositeCandidateCollection> candidates;
+		iEvent.getByToken(token_test, candidates);
+		test = candidates.product();
+	}
+	++nEvents_;
+
+	std::vector<Entry> ref = entries(*reference);
+	std::vector<Entry> tst = entries(*test);
+	std::vector<bool> used(tst.size(), false);
+	for (const Entry & r : ref) {
+		// the same pair and pdgId may carry two mass assignments, take the closest unused one
+		auto range = std::equal_range(tst.begin(), tst.end(), r);
+		int best = -1;
+		for (auto it = range.first; it != range.second; ++it) {
+			unsigned i = it - tst.begin();
+			if (used[i]) continue;
+			if (best < 0 || std::abs(it->cand->mass() - r.cand->mass()) < std::abs(tst[best].cand->mass() - r.cand->mass())) best = i;
+		}
+		if (best < 0) {
+			++nLost_;
+			log("lost", iEvent, r);
+			continue;
+		}
+		used[best] = true;
+		const reco::VertexCompositeCandidate & t = *tst[best].cand;
+		double dv = std::sqrt((t.vx() - r.cand->vx())*(t.vx() - r.cand->vx()) + (t.vy() - r.cand->vy())*(t.vy() - r.cand->vy())
+				+ (t.vz() - r.cand->vz())*(t.vz() - r.cand->vz()));
+		double massTolerance = massTolerance_ + relativeMassTolerance_*r.cand->p();
+		double vertexTolerance = vertexTolerance_ + relativeVertexTolerance_*std::sqrt(r.cand->vx()*r.cand->vx()
+				+ r.cand->vy()*r.cand->vy() + r.cand->vz()*r.cand->vz());
+		if (std::abs(t.mass() - r.cand->mass()) > massTolerance || dv > vertexTolerance) {
+			++nChanged_;
+			log("changed (reference)", iEvent, r);
+			log("changed (test)", iEvent, tst[best]);
+		} else {
+			++nMatched_;
+		}
+	}
+	for (unsigned i = 0; i < tst.size(); ++i) {
+		if (used[i]) continue;
+		++nGained_;
+		log("gained", iEvent, tst[i]);
+	}
+}
+
+void QWD0CandidateComparator::endJob()
+{
+	edm::LogVerbatim("QWD0CandidateComparator") << testLabel_ << " against the reference in " << nEvents_ << " events: "
+		<< nMatched_ << " matched, " << nLost_ << " lost, " << nGained_ << " gained, " << nChanged_ << " changed";
+	if (failOnDifference_ && (nLost_ || nGained_ || nChanged_)) {
+		throw cms::Exception("QWD0Regression") << testLabel_ << " differs from the reference: "
+			<< nLost_ << " lost, " << nGained_ << " gained, " << nChanged_ << " changed candidates";
+	}
+}
+
+DEFINE_FWK_MODULE(QWD0CandidateComparator);
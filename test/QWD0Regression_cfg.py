@@ -0,0 +1,167 @@
+# Golden-output regression of the QWD0Producer fast paths: the reference
+# loop (every pair, no prefilter, Kalman fit, serial) and each faster mode
+# of python/QWD0Modes_cff.py run on the same events, QWD0CandidateComparator checks that
+# they give the same D0 candidates by daughter track keys, pdgId, mass and
+# vertex; so does the QWD0GlobalProducer with the reference configuration.
+# Tests of the optional cuts are compared to a reference loop with the same
+# cuts switched on. The job fails if any candidate is lost, gained or changed.
+#
+#   cmsRun QWD0Regression_cfg.py inputFiles=file:tracks.root
+#   cmsRun QWD0Regression_cfg.py inputFiles=file:tracks.root copies=3 threads=4
+#
+# 'analytic' skips fits with a margin and is expected to lose a few
+# candidates, it only fails with strict=1.
+import FWCore.ParameterSet.Config as cms
+from FWCore.ParameterSet.VarParsing import VarParsing
+from QWAna.QWD0Producer.QWD0Modes_cff import registerOptions, configure, tracks, candidates, mode
+
+options = VarParsing('analysis')
+registerOptions(options)
+options.register('strict', 0, VarParsing.multiplicity.singleton, VarParsing.varType.int,
+		"also fail on differences of the analytic pre-fit")
+options.parseArguments()
+
+process = cms.Process("QWD0Regression")
+configure(process, options)
+
+process.QWD0Reference = candidates(options, 'bruteForce')
+process.p += process.QWD0Reference
+
+# further references, each the reference loop with more cuts or options
+# switched on; their tests keep the same settings, so the pruning behind
+# each of them is compared to the brute-force loop
+hypotheses = cms.VPSet(
+	cms.PSet(
+		label = cms.string('Kshort'),
+		mass1 = cms.double(0.13957018),
+		mass2 = cms.double(0.13957018),
+		mass = cms.double(0.497614),
+		massWindow = cms.double(0.07),
+		pdgId = cms.int32(310),
+		chargeConjugate = cms.bool(False)
+	),
+	cms.PSet(
+		label = cms.string('Lambda'),
+		mass1 = cms.double(0.938272046),
+		mass2 = cms.double(0.13957018),
+		mass = cms.double(1.115683),
+		massWindow = cms.double(0.05),
+		pdgId = cms.int32(3122)
+	),
+)
+# name: (changes, hypothesis labels compared)
+references = {
+	# the DCA window of the binned pair finder
+	'DCA': (dict(applyTkDCACut = cms.bool(True)), ['']),
+	# and the mPiPi and mass window branches of the prefilter
+	'Cuts': (dict(applyTkDCACut = cms.bool(True), applyMPiPiCut = cms.bool(True),
+		applyPrefitD0MassCut = cms.bool(True)), ['']),
+	'DzWindow': (dict(pairMaxDzSignificance = cms.double(3.)), ['']),
+	'DzVertex': (dict(vertexAssociation = cms.string('dz')), ['']),
+	'PointingVertex': (dict(vertexAssociation = cms.string('pointing')), ['']),
+	'Opposite': (dict(chargeCombination = cms.string('opposite')), ['']),
+	'Same': (dict(chargeCombination = cms.string('same')), ['']),
+	'Hypotheses': (dict(applyTkDCACut = cms.bool(True), applyMPiPiCut = cms.bool(True),
+		applyPrefitD0MassCut = cms.bool(True), extraHypotheses = hypotheses), ['', 'Kshort', 'Lambda']),
+	# the arbitration of the mass assignments, with swappedMass alone stored
+	'Single': (dict(extraHypotheses = hypotheses, massAssignment = cms.string('single')), ['', 'Kshort', 'Lambda']),
+}
+for name, (changes, labels) in sorted(references.items()):
+	setattr(process, 'QWD0Reference' + name, process.QWD0Reference.clone(**changes))
+	process.p += getattr(process, 'QWD0Reference' + name)
+
+# the tests of the parallel pair loop cut the events in small chunks
+def test(name):
+	changes = mode(name)
+	if changes['parallelMinTracks'].value() > 0:
+		changes['parallelChunkSize'] = cms.uint32(2)
+	return changes
+
+# name: (reference, changes); every mode of QWD0Modes_cff against the brute
+# force reference, and the prefilter and the TBB pair loop on their own
+tests = dict((name, ('', test(name))) for name in ['binned', 'scalarPrefilter', 'prefilter', 'parallel', 'analytic'])
+tests['bruteForcePrefilter'] = ('', dict(pairPrefilter = cms.bool(True)))
+tests['bruteForceParallel'] = ('', dict(parallelMinTracks = cms.uint32(1), parallelChunkSize = cms.uint32(2)))
+for name in references:
+	for fastMode in ['binned', 'prefilter', 'parallel']:
+		tests[fastMode + name] = (name, test(fastMode))
+
+# compares the hypothesis of two modules
+def comparator(reference, test, hypothesis, name, testFormat = 'candidates'):
+	return cms.EDAnalyzer("QWD0CandidateComparator",
+			reference = cms.InputTag(reference, hypothesis),
+			test = cms.InputTag(test, hypothesis),
+			testFormat = cms.string(testFormat),
+			tracks = tracks(options),
+			# the fit is deterministic, the tolerances only cover the output
+			# precision; the compact rows keep the vertex and the momenta in
+			# single precision, about 6e-8 relative
+			massTolerance = cms.double(1e-6),
+			vertexTolerance = cms.double(1e-6),
+			relativeMassTolerance = cms.double(1e-6 if testFormat == 'compact' else 0.),
+			relativeVertexTolerance = cms.double(1e-6 if testFormat == 'compact' else 0.),
+			failOnDifference = cms.bool(name != 'analytic' or options.strict != 0)
+			)
+
+for name, (reference, changes) in sorted(tests.items()):
+	label = 'QWD0' + name[0].upper() + name[1:]
+	setattr(process, label, getattr(process, 'QWD0Reference' + reference).clone(**changes))
+	process.p += getattr(process, label)
+	for hypothesis in (references[reference][1] if reference else ['']):
+		setattr(process, label + hypothesis + 'Comparator', comparator('QWD0Reference' + reference, label, hypothesis, name))
+		process.p += getattr(process, label + hypothesis + 'Comparator')
+
+# every pair prefilter kernel this CPU has: the scalar one against the
+# reference, the vector ones against the scalar one
+kernels = ['scalar']
+try:
+	with open('/proc/cpuinfo') as cpuinfo:
+		flags = set(' '.join(line for line in cpuinfo if line.startswith('flags')).split())
+except IOError:
+	flags = set()
+kernels += [kernel for kernel, flag in (('avx2', 'avx2'), ('avx512', 'avx512f')) if flag in flags]
+for kernel in kernels:
+	label = 'QWD0Kernel' + kernel[0].upper() + kernel[1:]
+	setattr(process, label, process.QWD0ReferenceHypotheses.clone(pairPrefilter = cms.bool(True),
+			pairPrefilterKernel = cms.string(kernel)))
+	process.p += getattr(process, label)
+	reference = 'QWD0ReferenceHypotheses' if kernel == 'scalar' else 'QWD0KernelScalar'
+	for hypothesis in references['Hypotheses'][1]:
+		setattr(process, label + hypothesis + 'Comparator', comparator(reference, label, hypothesis, 'kernel'))
+		process.p += getattr(process, label + hypothesis + 'Comparator')
+
+# the compact rows of the parallel mode, expanded, against the reference
+# candidates of every hypothesis, with both mass assignments and with the
+# closer one only
+for name in ['Hypotheses', 'Single']:
+	label = 'QWD0Compact' + ('' if name == 'Hypotheses' else name)
+	setattr(process, label, getattr(process, 'QWD0Reference' + name).clone(**dict(mode('parallel'),
+			outputFormat = cms.string('compact'))))
+	process.p += getattr(process, label)
+	for hypothesis in references[name][1]:
+		setattr(process, label + hypothesis + 'Comparator', comparator('QWD0Reference' + name, label,
+				hypothesis, 'compact', 'compact'))
+		process.p += getattr(process, label + hypothesis + 'Comparator')
+
+# maxCandidates and maxCandidatesPerTrack keep the same candidates in the
+# compact rows, also when the chunks of the parallel loop prune them on the way
+process.QWD0ReferenceCapped = process.QWD0ReferenceHypotheses.clone(maxCandidates = cms.uint32(5))
+process.QWD0ReferencePerTrack = process.QWD0ReferenceHypotheses.clone(maxCandidatesPerTrack = cms.uint32(1))
+process.QWD0CompactCapped = process.QWD0ReferenceCapped.clone(**dict(mode('parallel'),
+		outputFormat = cms.string('compact')))
+process.QWD0CompactPerTrack = process.QWD0ReferencePerTrack.clone(**dict(mode('parallel'),
+		outputFormat = cms.string('compact')))
+for name in ['Capped', 'PerTrack']:
+	process.p += getattr(process, 'QWD0Reference' + name)
+	process.p += getattr(process, 'QWD0Compact' + name)
+	for hypothesis in references['Hypotheses'][1]:
+		setattr(process, 'QWD0Compact' + name + hypothesis + 'Comparator', comparator('QWD0Reference' + name, 'QWD0Compact' + name,
+				hypothesis, 'compact', 'compact'))
+		process.p += getattr(process, 'QWD0Compact' + name + hypothesis + 'Comparator')
+
+# the edm::global module with the reference configuration, one fitter shared
+# by all streams
+process.QWD0Global = cms.EDProducer("QWD0GlobalProducer", process.QWD0Reference.parameters_())
+process.QWD0GlobalComparator = comparator('QWD0Reference', 'QWD0Global', '', 'global')
+process.p += process.QWD0Global
+process.p += process.QWD0GlobalComparator
@@ -0,0 +1,48 @@
+#!/usr/bin/env python
+# Runs QWD0Scaling_cfg.py for every mode, number of threads and copies and
+# collects the reports of QWD0ScalingRecorder into one JSON list, one entry
+# per job; a job that fails is recorded with its exit code.
+#
+#   python QWD0Scaling.py --input file:tracks.root --maxEvents 500 --output scaling.json
+#   python QWD0Scaling.py --input file:tracks.root --modes binned,parallel --threads 1,8,64 --copies 1,4
+import argparse
+import json
+import os
+import subprocess
+import sys
+import tempfile
+
+parser = argparse.ArgumentParser(description = "QWD0Producer scaling sweep")
+parser.add_argument('--input', required = True, help = "input file, e.g. file:tracks.root")
+parser.add_argument('--maxEvents', type = int, default = -1)
+parser.add_argument('--modes', default = 'bruteForce,binned,scalarPrefilter,prefilter,parallel')
+parser.add_argument('--threads', default = '1,2,4,8,16,32,64')
+parser.add_argument('--copies', default = '1', help = "track multiplication factors, for the multiplicity sweep")
+parser.add_argument('--output', default = 'scaling.json')
+args = parser.parse_args()
+
+cfg = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'QWD0Scaling_cfg.py')
+results = []
+workdir = tempfile.mkdtemp(prefix = 'qwd0scaling')
+for copies in args.copies.split(','):
+	for mode in args.modes.split(','):
+		for threads in args.threads.split(','):
+			report = os.path.join(workdir, '%s_%s_%s.json' % (mode, threads, copies))
+			command = ['cmsRun', cfg, 'inputFiles=' + args.input, 'maxEvents=%d' % args.maxEvents,
+					'mode=' + mode, 'threads=' + threads, 'copies=' + copies, 'report=' + report]
+			sys.stdout.write(' '.join(command) + '\n')
+			sys.stdout.flush()
+			with open(os.devnull, 'w') as devnull:
+				code = subprocess.call(command, stdout = devnull)
+			if code != 0 or not os.path.exists(report):
+				results.append(dict(mode = mode, threads = int(threads), copies = int(copies), exitCode = code))
+				continue
+			with open(report) as f:
+				results.append(json.load(f))
+			entry = results[-1]
+			sys.stdout.write('  %.2f events/s, %.0f fits/s, p99 %.1f ms, %.0f MB\n' % (entry['eventsPerSecond'],
+					entry['fitsPerSecond'], 1e3*entry['all']['latencyP99'], entry['peakRSSMB']))
+
+with open(args.output, 'w') as f:
+	json.dump(results, f, indent = 1)
+sys.stdout.write('wrote %s\n' % args.output)
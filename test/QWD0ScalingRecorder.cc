@@ -0,0 +1,152 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "FWCore/Framework/interface/Frameworkfwd.h"
+#include "FWCore/Framework/interface/global/EDAnalyzer.h"
+#include "FWCore/Framework/interface/Event.h"
+#include "FWCore/Framework/interface/MakerMacros.h"
+#include "FWCore/ParameterSet/interface/ParameterSet.h"
+#include "FWCore/MessageLogger/interface/MessageLogger.h"
+#include "FWCore/Utilities/interface/Exception.h"
+#include "FWCore/Utilities/interface/InputTag.h"
+#include "QWAna/QWD0Producer/interface/QWD0StageTimes.h"
+
+// Scaling benchmark of one QWD0Producer: collects the QWD0StageTimes of
+// every event and writes a JSON report at the end of the job with the
+// events per second, the vertex fits per second, the peak RSS and the
+// p50/p99 latency of fitAll, over all events and binned by the number of
+// tracks in the pair loop. The throughput is measured between the first and
+// the last event reaching the recorder, so the start of the job is left out.
+class dso_hidden QWD0ScalingRecorder final : public edm::global::EDAnalyzer<> {
+public:
+	explicit QWD0ScalingRecorder(const edm::ParameterSet&);
+
+private:
+	struct Sample {
+		unsigned nTracks;
+		unsigned long long nFits;
+		double latency;
+	};
+
+	void analyze(edm::StreamID, const edm::Event&, const edm::EventSetup&) const override;
+	void endJob() override;
+
+	// the events of [lo, hi) tracks as one JSON object
+	std::string summary(unsigned lo, unsigned hi) const;
+
+	edm::EDGetTokenT<QWD0StageTimes> token_times;
+	std::string mode_;
+	unsigned threads_;
+	unsigned copies_;
+	std::vector<unsigned> trackBins_;
+	std::string report_;
+
+	mutable std::mutex mutex_;
+	mutable std::vector<Sample> samples_;
+	mutable std::chrono::steady_clock::time_point first_;
+	mutable std::chrono::steady_clock::time_point last_;
+};
+
+namespace {
+	// the q-quantile of sorted values, nearest rank
+	double quantile(const std::vector<double> & sorted, double q) {
+		if (sorted.empty()) return 0.;
+		size_t rank = std::min(sorted.size() - 1, size_t(q*sorted.size()));
+		return sorted[rank];
+	}
+
+	// high water mark of the resident set [MB], 0 if /proc is not there
+	double peakRSS() {
+		std::ifstream status("/proc/self/status");
+		std::string line;
+		while (std::getline(status, line)) {
+			unsigned long kB = 0;
+			if (std::sscanf(line.c_str(), "VmHWM: %lu kB", &kB) == 1) return kB/1024.;
+		}
+		return 0.;
+	}
+}
+
+QWD0ScalingRecorder::QWD0ScalingRecorder(const edm::ParameterSet& iConfig) :
+	token_times(consumes<QWD0StageTimes>(iConfig.getParameter<edm::InputTag>("src"))),
+	mode_(iConfig.getParameter<std::string>("mode")),
+	threads_(iConfig.getParameter<unsigned>("threads")),
+	copies_(iConfig.getParameter<unsigned>("copies")),
+	trackBins_(iConfig.getParameter<std::vector<unsigned>>("trackBins")),
+	report_(iConfig.getParameter<std::string>("report"))
+{
+	if (!std::is_sorted(trackBins_.begin(), trackBins_.end())) {
+		throw cms::Exception("Configuration") << "QWD0ScalingRecorder: trackBins must be increasing";
+	}
+}
+
+void QWD0ScalingRecorder::analyze(edm::StreamID, const edm::Event& iEvent, const edm::EventSetup&) const
+{
+	edm::Handle<QWD0StageTimes> times;
+	iEvent.getByToken(token_times, times);
+
+	Sample sample = {times->nTracks(), times->nFits(), times->eventTime()};
+	auto now = std::chrono::steady_clock::now();
+	std::lock_guard<std::mutex> guard(mutex_);
+	if (samples_.empty()) first_ = now;
+	last_ = now;
+	samples_.push_back(sample);
+}
+
+std::string QWD0ScalingRecorder::summary(unsigned lo, unsigned hi) const
+{
+	std::vector<double> latencies;
+	unsigned long long nFits = 0;
+	double busy = 0.;
+	for (const Sample & sample : samples_) {
+		if (sample.nTracks < lo || sample.nTracks >= hi) continue;
+		latencies.push_back(sample.latency);
+		nFits += sample.nFits;
+		busy += sample.latency;
+	}
+	std::sort(latencies.begin(), latencies.end());
+
+	// fitRate is per second inside fitAll, not the throughput of the job
+	char line[512];
+	std::snprintf(line, sizeof(line), "{\"minTracks\": %u, \"maxTracks\": %u, \"events\": %zu, \"fits\": %llu, "
+			"\"fitRate\": %.1f, \"latencyP50\": %.6f, \"latencyP99\": %.6f, \"latencyMean\": %.6f}",
+			lo, hi, latencies.size(), nFits, busy > 0. ? nFits/busy : 0.,
+			quantile(latencies, 0.5), quantile(latencies, 0.99), latencies.empty() ? 0. : busy/latencies.size());
+	return line;
+}
+
+void QWD0ScalingRecorder::endJob()
+{
+	double elapsed = std::chrono::duration<double>(last_ - first_).count();
+	unsigned long long nFits = 0;
+	for (const Sample & sample : samples_) nFits += sample.nFits;
+	// the fits of the first event are before the clock starts
+	if (!samples_.empty()) nFits -= samples_.front().nFits;
+	const unsigned maxTracks = ~0u;
+
+	char line[512];
+	std::snprintf(line, sizeof(line), "{\"mode\": \"%s\", \"threads\": %u, \"copies\": %u, \"events\": %zu, "
+			"\"elapsed\": %.3f, \"eventsPerSecond\": %.3f, \"fitsPerSecond\": %.1f, \"peakRSSMB\": %.1f",
+			mode_.c_str(), threads_, copies_, samples_.size(), elapsed,
+			elapsed > 0. ? (samples_.size() - 1)/elapsed : 0., elapsed > 0. ? nFits/elapsed : 0., peakRSS());
+	std::string json = line;
+	json += ",\n \"all\": " + summary(0, maxTracks) + ",\n \"bins\": [";
+	for (unsigned ibin = 0; ibin < trackBins_.size(); ++ibin) {
+		unsigned hi = ibin + 1 < trackBins_.size() ? trackBins_[ibin + 1] : maxTracks;
+		json += (ibin ? ",\n  " : "\n  ") + summary(trackBins_[ibin], hi);
+	}
+	json += "\n ]}\n";
+
+	edm::LogVerbatim("QWD0ScalingRecorder") << json;
+	if (report_.empty()) return;
+	std::ofstream out(report_);
+	out << json;
+	if (!out) throw cms::Exception("QWD0ScalingRecorder") << "could not write " << report_;
+}
+
+DEFINE_FWK_MODULE(QWD0ScalingRecorder);
@@ -0,0 +1,38 @@
+# Scaling benchmark of one QWD0Producer mode at a given number of threads:
+# QWD0ScalingRecorder writes a JSON report with the events per second, the
+# vertex fits per second, the peak RSS and the p50/p99 latency of fitAll per
+# event, over all events and binned by the number of tracks in the pair
+# loop. QWD0Scaling.py runs the sweep over modes, threads and copies and
+# collects the reports; one job is
+#   cmsRun QWD0Scaling_cfg.py inputFiles=file:tracks.root mode=binned threads=8 report=binned_8.json
+#
+# the modes are the ones of python/QWD0Modes_cff.py
+import FWCore.ParameterSet.Config as cms
+from FWCore.ParameterSet.VarParsing import VarParsing
+from QWAna.QWD0Producer.QWD0Modes_cff import registerOptions, configure, candidates
+
+options = VarParsing('analysis')
+registerOptions(options)
+options.register('mode', 'binned', VarParsing.multiplicity.singleton, VarParsing.varType.string,
+		"configuration to time")
+options.register('report', '', VarParsing.multiplicity.singleton, VarParsing.varType.string,
+		"JSON report file, '' only logs it")
+options.parseArguments()
+
+process = cms.Process("QWD0Scaling")
+# one stream per thread
+configure(process, options, streams = options.threads, reportEvery = 1000)
+
+process.QWD0Candidates = candidates(options, options.mode, storeStageTimes = cms.bool(True))
+process.p += process.QWD0Candidates
+
+process.QWD0ScalingRecorder = cms.EDAnalyzer("QWD0ScalingRecorder",
+		src = cms.InputTag('QWD0Candidates'),
+		mode = cms.string(options.mode),
+		threads = cms.uint32(options.threads),
+		copies = cms.uint32(options.copies),
+		# lower edges of the bins in tracks in the pair loop
+		trackBins = cms.vuint32(0, 50, 100, 200, 400, 800, 1600, 3200),
+		report = cms.string(options.report)
+		)
+process.e = cms.EndPath(process.QWD0ScalingRecorder)
@@ -0,0 +1,70 @@
+#include <algorithm>
+#include <cmath>
+#include <memory>
+
+#include "FWCore/Framework/interface/Frameworkfwd.h"
+#include "FWCore/Framework/interface/global/EDProducer.h"
+#include "FWCore/Framework/interface/Event.h"
+#include "FWCore/Framework/interface/MakerMacros.h"
+#include "FWCore/ParameterSet/interface/ParameterSet.h"
+#include "FWCore/Utilities/interface/InputTag.h"
+#include "DataFormats/BeamSpot/interface/BeamSpot.h"
+#include "DataFormats/TrackReco/interface/Track.h"
+
+// Scales the track multiplicity of an event for the QWD0Producer benchmarks:
+// writes the tracks of src followed by copies-1 copies of them, each rotated
+// about the beam line by a fixed angle. The rotation keeps the impact
+// parameters, the errors and the z of every track, so the copies pass the
+// same preselection and multiply the pairs roughly by copies^2. The copies
+// have no hit pattern or TrackExtra, configure tkNHitsCut = 0 and
+// applyInnerHitPosCut = False when they are used.
+class dso_hidden QWD0TrackMultiplier final : public edm::global::EDProducer<> {
+public:
+	explicit QWD0TrackMultiplier(const edm::ParameterSet&);
+
+private:
+	void produce(edm::StreamID, edm::Event&, const edm::EventSetup&) const override;
+
+	edm::EDGetTokenT<reco::TrackCollection> token_tracks;
+	edm::EDGetTokenT<reco::BeamSpot> token_beamSpot;
+	unsigned copies_;
+};
+
+QWD0TrackMultiplier::QWD0TrackMultiplier(const edm::ParameterSet& iConfig) :
+	token_tracks(consumes<reco::TrackCollection>(iConfig.getParameter<edm::InputTag>("src"))),
+	token_beamSpot(consumes<reco::BeamSpot>(iConfig.getParameter<edm::InputTag>("beamSpot"))),
+	copies_(std::max(1u, iConfig.getParameter<unsigned>("copies")))
+{
+	produces< reco::TrackCollection >();
+}
+
+void QWD0TrackMultiplier::produce(edm::StreamID, edm::Event& iEvent, const edm::EventSetup&) const
+{
+	edm::Handle<reco::TrackCollection> tracks;
+	iEvent.getByToken(token_tracks, tracks);
+	edm::Handle<reco::BeamSpot> beamSpot;
+	iEvent.getByToken(token_beamSpot, beamSpot);
+
+	std::auto_ptr< reco::TrackCollection > out( new reco::TrackCollection(*tracks) );
+	out->reserve(copies_*tracks->size());
+	double x0 = beamSpot->x0();
+	double y0 = beamSpot->y0();
+	for (unsigned icopy = 1; icopy < copies_; ++icopy) {
+		// golden angle steps spread any number of copies in phi
+		double angle = icopy*M_PI*(3. - std::sqrt(5.));
+		double c = std::cos(angle);
+		double s = std::sin(angle);
+		for (const reco::Track & track : *tracks) {
+			const reco::Track::Point & ref = track.referencePoint();
+			reco::Track::Point rotatedRef(x0 + c*(ref.x() - x0) - s*(ref.y() - y0), y0 + s*(ref.x() - x0) + c*(ref.y() - y0), ref.z());
+			reco::Track::Vector rotatedMomentum(c*track.px() - s*track.py(), s*track.px() + c*track.py(), track.pz());
+			// the curvilinear covariance does not change under a rotation about z
+			out->push_back(reco::Track(track.chi2(), track.ndof(), rotatedRef, rotatedMomentum, track.charge(),
+						track.covariance(), track.algo()));
+			out->back().setQualityMask(track.qualityMask());
+		}
+	}
+	iEvent.put( out );
+}
+
+DEFINE_FWK_MODULE(QWD0TrackMultiplier);